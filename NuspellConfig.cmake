@@ -1,3 +1,4 @@
 include(CMakeFindDependencyMacro)
 find_dependency(ICU COMPONENTS uc data)
+find_dependency(Threads)
 include("${CMAKE_CURRENT_LIST_DIR}/NuspellTargets.cmake")
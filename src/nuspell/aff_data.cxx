@@ -19,6 +19,7 @@
 #include "aff_data.hxx"
 #include "utils.hxx"
 
+#include <cstring>
 #include <iostream>
 #include <sstream>
 #include <unordered_map>
@@ -37,7 +38,7 @@ namespace nuspell {
  * verison. Look up on the Internet to see what is it for (ABI versioning
  * mostly). Client code should never mention this inline namespace.
  */
-inline namespace v5 {
+inline namespace v6 {
 
 auto Encoding::normalize_name() -> void
 {
@@ -48,6 +49,222 @@ auto Encoding::normalize_name() -> void
 		name.erase(0, 10);
 }
 
+/**
+ * @internal
+ * @brief Copies the key into the arena.
+ * @param key the word
+ * @return view of the copy in the arena
+ */
+auto Word_List::store_key(std::string_view key) -> std::string_view
+{
+	if (key.empty())
+		return {};
+	if (key.size() > arena_free_size) {
+		auto chunk_size = max(arena_chunk_size, key.size());
+		auto chunk = arena.emplace_back(new char[chunk_size]).get();
+		if (chunk_size - key.size() < arena_free_size) {
+			// big key, keep using the free space of the old chunk
+			copy(begin(key), end(key), chunk);
+			return {chunk, key.size()};
+		}
+		arena_free = chunk;
+		arena_free_size = chunk_size;
+	}
+	auto ret = string_view(arena_free, key.size());
+	arena_free = copy(begin(key), end(key), arena_free);
+	arena_free_size -= key.size();
+	return ret;
+}
+
+/**
+ * @internal
+ * @brief Adds the flag set to the pool of distinct flag sets.
+ * @param flags flag set
+ * @return pointer to the flag set in the pool that is equal to @p flags
+ */
+auto Word_List::intern(const Flag_Set& flags) -> const Flag_Set_With_Roles*
+{
+	auto key = u16string_view(flags.data(), flags.size());
+	auto [first, last] = flag_sets_index.equal_range(key);
+	if (first != last)
+		return first->second;
+	auto& f = flag_sets.emplace_back(flags);
+	f.assign_roles(role_flags);
+	flag_sets_index.emplace(u16string_view(f.data(), f.size()), &f);
+	return &f;
+}
+
+/**
+ * @internal
+ * @brief Switches the lookups to a perfect hash table.
+ *
+ * Building the perfect hash function takes time, but after that every lookup
+ * computes the position of the key directly and the table has no empty
+ * slots. Meant for lists that will not be modified anymore.
+ *
+ * @return true on success, false if the perfect hash table could not be built,
+ * in which case the list keeps using the ordinary hash table.
+ */
+auto Word_List::freeze() -> bool
+{
+	if (frozen)
+		return true;
+	if (!frozen_table.build(table))
+		return false;
+	frozen_capacity = table.capacity();
+	table = Table();
+	frozen = true;
+	return true;
+}
+
+auto Word_List::unfreeze() -> void
+{
+	auto t = Table();
+	if (frozen_capacity != 0)
+		t.rehash(frozen_capacity - 1);
+	for (size_t i = 0; i != frozen_table.bucket_count(); ++i) {
+		for (auto& x : frozen_table.bucket_data(i))
+			t.insert(Table::value_type(x));
+	}
+	table = std::move(t);
+	frozen_table.clear();
+	frozen_capacity = 0;
+	frozen = false;
+}
+
+/**
+ * @internal
+ * @brief Builds the Bloom filter of the keys.
+ *
+ * Until it is called might_contain() returns true for every key. Keys added
+ * after it are added to the filter too.
+ */
+auto Word_List::build_filter() -> void
+{
+	filter = Bloom_Filter(size());
+	for (size_t i = 0; i != bucket_count(); ++i) {
+		for (auto& x : bucket_data(i))
+			filter.insert(x.first);
+	}
+}
+
+/**
+ * @internal
+ * @brief Replaces the words with a frozen table built elsewhere.
+ *
+ * The flag sets must be interned into this list first, the elements of the
+ * table point to them. The keys, the tables and the filter can view memory
+ * owned by @p owner, this list and its copies keep it alive.
+ *
+ * @param t perfect hash table
+ * @param capacity capacity of the Hash_Multimap the table was built from
+ * @param f Bloom filter of the keys
+ * @param owner owner of the viewed memory, can be null
+ */
+auto Word_List::assign_frozen(Frozen_Table&& t, size_t capacity,
+                              Bloom_Filter&& f,
+                              std::shared_ptr<const void> owner) -> void
+{
+	table = Table();
+	frozen_table = std::move(t);
+	frozen_capacity = capacity;
+	frozen = true;
+	filter = std::move(f);
+	storage = std::move(owner);
+}
+
+/**
+ * @internal
+ * @brief Copy constructor.
+ *
+ * The tables are copied as they are, frozen or not, and then the pointers to
+ * the keys and to the flag sets of the other list are replaced with pointers
+ * to the ones of this list. The keys that are viewed in the storage are
+ * shared instead of copied, the storage keeps them alive for both lists.
+ */
+Word_List::Word_List(const Word_List& other)
+    : table(other.table), frozen_table(other.frozen_table),
+      frozen_capacity(other.frozen_capacity), frozen(other.frozen),
+      role_flags(other.role_flags), filter(other.filter),
+      storage(other.storage)
+{
+	auto new_flags = unordered_map<const Flag_Set_With_Roles*,
+	                               const Flag_Set_With_Roles*>();
+	new_flags.reserve(other.flag_sets.size());
+	for (auto& f : other.flag_sets)
+		new_flags.emplace(&f, intern(f));
+	auto in_other_arena = [&](string_view key) {
+		if (!other.storage)
+			return true;
+		// A chunk bigger than the usual size holds one key that starts
+		// at the beginning of the chunk.
+		auto less = std::less<const char*>();
+		for (auto& chunk : other.arena) {
+			auto p = chunk.get();
+			if (!less(key.data(), p) &&
+			    less(key.data(), p + arena_chunk_size))
+				return true;
+		}
+		return false;
+	};
+	// Entries with equal keys are adjacent and share the characters.
+	auto old_key = string_view();
+	auto new_key = string_view();
+	auto copy_entry = [&](const value_type& x) {
+		if (x.first.data() != old_key.data() ||
+		    x.first.size() != old_key.size()) {
+			old_key = x.first;
+			new_key = in_other_arena(old_key) ? store_key(old_key)
+			                                  : old_key;
+		}
+		return value_type(new_key, new_flags.find(x.second)->second);
+	};
+	if (frozen)
+		frozen_table.transform_elements(copy_entry);
+	else
+		table.transform_elements(copy_entry);
+}
+
+/**
+ * @internal
+ * @brief Move constructor.
+ *
+ * The moved-from list is left empty. It does not keep pointers into the arena
+ * that now belongs to this list, so adding words to it later is safe.
+ */
+Word_List::Word_List(Word_List&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+auto Word_List::operator=(const Word_List& other) -> Word_List&
+{
+	if (this != &other)
+		*this = Word_List(other);
+	return *this;
+}
+
+auto Word_List::operator=(Word_List&& other) noexcept -> Word_List&
+{
+	if (this == &other)
+		return *this;
+	table = exchange(other.table, Table());
+	frozen_table = exchange(other.frozen_table, Frozen_Table());
+	frozen_capacity = exchange(other.frozen_capacity, 0);
+	frozen = exchange(other.frozen, false);
+	arena = std::move(other.arena);
+	other.arena.clear();
+	arena_free = exchange(other.arena_free, nullptr);
+	arena_free_size = exchange(other.arena_free_size, 0);
+	flag_sets = std::move(other.flag_sets);
+	other.flag_sets.clear();
+	flag_sets_index = exchange(other.flag_sets_index, {});
+	role_flags = other.role_flags;
+	filter = exchange(other.filter, Bloom_Filter());
+	storage = std::move(other.storage);
+	return *this;
+}
+
 namespace {
 
 void reset_failbit_istream(std::istream& in)
@@ -668,7 +885,8 @@ auto parse_affix(istream& in, Aff_Line_IO_Manip& p, string& command,
 		in >> p(elem.stripping);
 		if (elem.stripping == "0")
 			elem.stripping.clear();
-		in >> p(elem.appending, elem.cont_flags);
+		in >> p(elem.appending,
+		         static_cast<Flag_Set&>(elem.cont_flags));
 		if (elem.appending == "0")
 			elem.appending.clear();
 		if (in.fail())
@@ -690,8 +908,431 @@ auto parse_affix(istream& in, Aff_Line_IO_Manip& p, string& command,
 	}
 }
 
+
+/**
+ * @internal
+ * @brief Magic bytes at the start of a compiled dictionary.
+ */
+constexpr auto COMPILED_MAGIC = string_view("NUSPELLC");
+
+/**
+ * @internal
+ * @brief Version of the compiled dictionary format.
+ *
+ * Bump it on every change of the format. Files with different version are
+ * rejected and the dictionary must be compiled again from .aff and .dic.
+ */
+constexpr auto COMPILED_VERSION = uint32_t(4);
+
+/**
+ * @internal
+ * @brief Hash of a fixed string, identifies the std::hash of the library.
+ *
+ * The perfect hash function and the Bloom filter of the word list depend on
+ * it, so they are used from the file only if it matches.
+ */
+auto compiled_hash_check() -> uint64_t
+{
+	return Word_List::hash(COMPILED_MAGIC);
+}
+
+auto is_little_endian() -> bool
+{
+	auto x = uint16_t(1);
+	auto c = char();
+	memcpy(&c, &x, 1);
+	return c == 1;
+}
+
+auto read_u32_le(const char* p) -> uint32_t
+{
+	auto x = uint32_t(0);
+	for (size_t i = 0; i != 4; ++i)
+		x |= uint32_t(static_cast<unsigned char>(p[i])) << (8 * i);
+	return x;
+}
+
+/**
+ * @internal
+ * @brief Views an array of a compiled file on a little endian machine.
+ *
+ * The array is copied if its address is not aligned for T, as can happen
+ * when the file is read into a buffer instead of mapped.
+ */
+template <class T>
+auto view_or_copy(string_view bytes) -> Mappable_Array<T>
+{
+	auto n = bytes.size() / sizeof(T);
+	auto a = Mappable_Array<T>();
+	if (reinterpret_cast<uintptr_t>(bytes.data()) % alignof(T) == 0) {
+		a.view(reinterpret_cast<const T*>(bytes.data()), n);
+	}
+	else {
+		auto v = vector<T>(n);
+		memcpy(v.data(), bytes.data(), n * sizeof(T));
+		a = move(v);
+	}
+	return a;
+}
+
+/**
+ * @internal
+ * @brief Writes values in the compiled format.
+ *
+ * All integers are written in little endian byte order, strings and vectors
+ * are prefixed by their length. The output has no pointers or platform
+ * dependent layout so it can be loaded at any address on any platform.
+ * Arrays that are meant to be viewed in place are aligned with pad_to().
+ */
+class Compiled_Writer {
+	ostream& out;
+	size_t pos = 0;
+
+	auto put_uint(uint64_t x, size_t num_bytes) -> void
+	{
+		char buf[8];
+		for (size_t i = 0; i != num_bytes; ++i, x >>= 8)
+			buf[i] = char(x & 0xFF);
+		put_bytes({buf, num_bytes});
+	}
+
+      public:
+	explicit Compiled_Writer(ostream& out) : out(out) {}
+	auto put_bytes(string_view s) -> void
+	{
+		out.write(s.data(), s.size());
+		pos += s.size();
+	}
+	/**
+	 * @brief Writes zeros up to a multiple of @p alignment from the start.
+	 */
+	auto pad_to(size_t alignment) -> void
+	{
+		for (; pos % alignment != 0; ++pos)
+			out.put('\0');
+	}
+	auto& operator&(bool x)
+	{
+		put_uint(x, 1);
+		return *this;
+	}
+	auto& operator&(char16_t x)
+	{
+		put_uint(x, 2);
+		return *this;
+	}
+	auto& operator&(unsigned short x)
+	{
+		put_uint(x, 2);
+		return *this;
+	}
+	auto& operator&(uint32_t x)
+	{
+		put_uint(x, 4);
+		return *this;
+	}
+	auto& operator&(uint64_t x)
+	{
+		put_uint(x, 8);
+		return *this;
+	}
+	auto& operator&(string_view s)
+	{
+		*this & uint32_t(s.size());
+		put_bytes(s);
+		return *this;
+	}
+	auto& operator&(const string& s) { return *this & string_view(s); }
+	auto& operator&(u16string_view s)
+	{
+		*this & uint32_t(s.size());
+		for (auto c : s)
+			*this & c;
+		return *this;
+	}
+	auto& operator&(const u16string& s) { return *this & u16string_view(s); }
+	auto& operator&(const Flag_Set& s)
+	{
+		return *this & u16string_view(s.data(), s.size());
+	}
+	template <class T>
+	auto& operator&(const T* p) = delete; // do not write pointers as bool
+	template <class T, class U>
+	auto& operator&(const pair<T, U>& p)
+	{
+		return *this & p.first & p.second;
+	}
+	template <class T>
+	auto& operator&(const vector<T>& v)
+	{
+		*this & uint32_t(v.size());
+		for (auto& x : v)
+			*this & x;
+		return *this;
+	}
+	auto& operator&(const Prefix& a)
+	{
+		return *this & a.flag & a.cross_product & a.stripping &
+		       a.appending & a.cont_flags & a.condition.str();
+	}
+	auto& operator&(const Suffix& a)
+	{
+		return *this & a.flag & a.cross_product & a.stripping &
+		       a.appending & a.cont_flags & a.condition.str();
+	}
+	auto& operator&(const Similarity_Group& g)
+	{
+		return *this & g.chars & g.strings;
+	}
+	auto& operator&(const Compound_Pattern& p)
+	{
+		return *this & p.begin_end_chars.str() &
+		       uint32_t(p.begin_end_chars.idx()) & p.replacement &
+		       p.first_word_flag & p.second_word_flag &
+		       p.match_first_only_unaffixed_or_zero_affixed;
+	}
+	auto good() const { return out.good(); }
+};
+
+/**
+ * @internal
+ * @brief Reads values written by Compiled_Writer from a memory buffer.
+ *
+ * Reading past the end of the buffer, invalid UTF-8 or inconsistent data sets
+ * the object into failed state. After that all reads are no-ops.
+ */
+class Compiled_Reader {
+	const char* first;
+	const char* ptr;
+	const char* last;
+	bool ok = true;
+
+	auto get_uint(size_t num_bytes) -> uint64_t
+	{
+		if (size_t(last - ptr) < num_bytes) {
+			ok = false;
+			ptr = last;
+			return 0;
+		}
+		auto x = uint64_t(0);
+		for (size_t i = 0; i != num_bytes; ++i)
+			x |= uint64_t(static_cast<unsigned char>(ptr[i]))
+			     << (8 * i);
+		ptr += num_bytes;
+		return x;
+	}
+	auto get_size(size_t min_element_size) -> size_t
+	{
+		auto n = size_t(get_uint(4));
+		if (n > size_t(last - ptr) / min_element_size) {
+			ok = false;
+			ptr = last;
+			return 0;
+		}
+		return n;
+	}
+
+      public:
+	explicit Compiled_Reader(string_view data)
+	    : first(data.data()), ptr(data.data()),
+	      last(data.data() + data.size())
+	{
+	}
+	auto get_bytes(size_t n) -> string_view
+	{
+		if (size_t(last - ptr) < n) {
+			ok = false;
+			ptr = last;
+			return {};
+		}
+		auto ret = string_view(ptr, n);
+		ptr += n;
+		return ret;
+	}
+	/**
+	 * @brief Reads an array written after Compiled_Writer::pad_to().
+	 * @param n number of elements
+	 * @param elem_size size of one element in bytes
+	 * @param alignment the argument of Compiled_Writer::pad_to()
+	 * @return the bytes of the array
+	 */
+	auto get_array(uint64_t n, size_t elem_size, size_t alignment)
+	    -> string_view
+	{
+		get_bytes((alignment - size_t(ptr - first) % alignment) %
+		          alignment);
+		if (n > size_t(last - ptr) / elem_size) {
+			ok = false;
+			ptr = last;
+			return {};
+		}
+		return get_bytes(n * elem_size);
+	}
+	auto& operator&(bool& x)
+	{
+		x = get_uint(1);
+		return *this;
+	}
+	auto& operator&(char16_t& x)
+	{
+		x = get_uint(2);
+		return *this;
+	}
+	auto& operator&(unsigned short& x)
+	{
+		x = get_uint(2);
+		return *this;
+	}
+	auto& operator&(uint32_t& x)
+	{
+		x = get_uint(4);
+		return *this;
+	}
+	auto& operator&(uint64_t& x)
+	{
+		x = get_uint(8);
+		return *this;
+	}
+	auto get_view() -> string_view
+	{
+		auto n = get_size(1);
+		auto ret = string_view(ptr, n);
+		ptr += n;
+		// All strings are UTF-8 and the rest of the library relies on
+		// them being valid.
+		if (!validate_utf8(ret)) {
+			ok = false;
+			ptr = last;
+			return {};
+		}
+		return ret;
+	}
+	auto& operator&(string& s)
+	{
+		s = get_view();
+		return *this;
+	}
+	auto& operator&(u16string& s)
+	{
+		s.resize(get_size(2));
+		for (auto& c : s)
+			*this & c;
+		return *this;
+	}
+	auto& operator&(Flag_Set& s)
+	{
+		auto t = u16string();
+		*this & t;
+		s = move(t);
+		return *this;
+	}
+	template <class T, class U>
+	auto& operator&(pair<T, U>& p)
+	{
+		return *this & p.first & p.second;
+	}
+	template <class T>
+	auto& operator&(vector<T>& v)
+	{
+		v.resize(get_size(1));
+		for (auto& x : v)
+			*this & x;
+		return *this;
+	}
+	template <class AffixT>
+	auto& get_affix(AffixT& a)
+	{
+		auto cond = string();
+		*this & a.flag & a.cross_product & a.stripping & a.appending &
+		    a.cont_flags & cond;
+		a.condition = move(cond);
+		return *this;
+	}
+	auto& operator&(Prefix& a) { return get_affix(a); }
+	auto& operator&(Suffix& a) { return get_affix(a); }
+	auto& operator&(Similarity_Group& g)
+	{
+		return *this & g.chars & g.strings;
+	}
+	auto& operator&(Compound_Pattern& p)
+	{
+		auto s = string();
+		auto i = uint32_t();
+		*this & s & i & p.replacement & p.first_word_flag &
+		    p.second_word_flag &
+		    p.match_first_only_unaffixed_or_zero_affixed;
+		if (i > s.size()) {
+			ok = false;
+			return *this;
+		}
+		p.begin_end_chars = String_Pair(move(s), i);
+		return *this;
+	}
+	auto good() const { return ok; }
+	auto at_end() const { return ptr == last; }
+};
+
+/**
+ * @internal
+ * @brief Writes or reads the options of Aff_Data that are plain values.
+ *
+ * Shared between saving and loading so the two can not get out of sync.
+ */
+template <class Archive, class Aff_Data_T>
+auto serialize_simple_options(Archive& ar, Aff_Data_T& d) -> void
+{
+	ar & d.complex_prefixes & d.fullstrip & d.checksharps & d.forbid_warn;
+	ar & d.compound_onlyin_flag & d.circumfix_flag &
+	    d.forbiddenword_flag & d.keepcase_flag & d.need_affix_flag &
+	    d.warn_flag;
+	ar & d.compound_flag & d.compound_begin_flag & d.compound_last_flag &
+	    d.compound_middle_flag;
+	ar & d.ignored_chars;
+	ar & d.keyboard_closeness & d.try_chars;
+	ar & d.nosuggest_flag & d.substandard_flag &
+	    d.max_compound_suggestions & d.max_ngram_suggestions &
+	    d.max_diff_factor & d.only_max_diff & d.no_split_suggestions &
+	    d.suggest_with_dots;
+	ar & d.compound_min_length & d.compound_max_word_count &
+	    d.compound_permit_flag & d.compound_forbid_flag &
+	    d.compound_root_flag & d.compound_force_uppercase &
+	    d.compound_more_suffixes & d.compound_check_duplicate &
+	    d.compound_check_rep & d.compound_check_case &
+	    d.compound_check_triple & d.compound_simplified_triple &
+	    d.compound_syllable_num & d.compound_syllable_max &
+	    d.compound_syllable_vowels & d.compound_patterns;
+	ar & d.similarities;
+}
+
 } // namespace
 
+/**
+ * @internal
+ * @brief Gets the flags that have special meaning in this dictionary.
+ */
+auto Aff_Data::get_role_flags() const -> Role_Flags
+{
+	auto r = Role_Flags();
+	r.set(ROLE_FORBIDDENWORD, forbiddenword_flag);
+	r.set(ROLE_NEEDAFFIX, need_affix_flag);
+	r.set(ROLE_ONLYINCOMPOUND, compound_onlyin_flag);
+	r.set(ROLE_HIDDEN_HOMONYM, HIDDEN_HOMONYM_FLAG);
+	r.set(ROLE_NOSUGGEST, nosuggest_flag);
+	r.set(ROLE_KEEPCASE, keepcase_flag);
+	r.set(ROLE_CIRCUMFIX, circumfix_flag);
+	r.set(ROLE_WARN, warn_flag);
+	r.set(ROLE_SUBSTANDARD, substandard_flag);
+	r.set(ROLE_COMPOUNDFLAG, compound_flag);
+	r.set(ROLE_COMPOUNDBEGIN, compound_begin_flag);
+	r.set(ROLE_COMPOUNDMIDDLE, compound_middle_flag);
+	r.set(ROLE_COMPOUNDEND, compound_last_flag);
+	r.set(ROLE_COMPOUNDPERMITFLAG, compound_permit_flag);
+	r.set(ROLE_COMPOUNDFORBIDFLAG, compound_forbid_flag);
+	r.set(ROLE_COMPOUNDROOT, compound_root_flag);
+	r.set(ROLE_FORCEUCASE, compound_force_uppercase);
+	return r;
+}
+
 auto Aff_Data::parse_aff(istream& in) -> bool
 {
 	auto prefixes = vector<Prefix>();
@@ -915,14 +1556,18 @@ auto Aff_Data::parse_aff(istream& in) -> bool
 	output_substr_replacer = std::move(output_conversion);
 	this->replacements = std::move(replacements);
 	// phonetic_table = std::move(phonetic_replacements);
+	auto role_flags = get_role_flags();
 	for (auto& x : prefixes) {
 		erase_chars(x.appending, ignored_chars);
+		x.cont_flags.assign_roles(role_flags);
 	}
 	for (auto& x : suffixes) {
 		erase_chars(x.appending, ignored_chars);
+		x.cont_flags.assign_roles(role_flags);
 	}
 	this->prefixes = std::move(prefixes);
 	this->suffixes = std::move(suffixes);
+	words.set_role_flags(role_flags);
 
 	cerr.flush();
 	return in.eof() && !error_happened; // true for success
@@ -1039,7 +1684,7 @@ auto Aff_Data::parse_dic(istream& in) -> bool
 			// forbiddenword_flag, but by keeping the hidden
 			// homonym last in the multimap among the same-key
 			// entries.
-			if (inserted->second.contains(forbiddenword_flag))
+			if (inserted->second->roles & ROLE_FORBIDDENWORD)
 				break;
 			to_title(u8word, icu_locale, u8word);
 			flags += HIDDEN_HOMONYM_FLAG;
@@ -1050,7 +1695,282 @@ auto Aff_Data::parse_dic(istream& in) -> bool
 			break;
 		}
 	}
+	words.build_filter();
 	return in.eof() && success; // success if we reached eof
 }
-} // namespace v5
+
+/**
+ * @internal
+ * @brief Writes the parsed dictionary in the compiled binary format.
+ *
+ * The compiled format stores the data after all the processing done by
+ * parse_aff() and parse_dic(), so loading it with load_compiled() skips the
+ * text parsing, flag decoding and encoding conversion. The word list is
+ * stored frozen, a copy of it is frozen if it is not.
+ *
+ * @param out binary output stream
+ * @return true on success, false on write error
+ */
+auto Aff_Data::save_compiled(std::ostream& out) const -> bool
+{
+	auto w = Compiled_Writer(out);
+	w.put_bytes(COMPILED_MAGIC);
+	w & COMPILED_VERSION;
+	w & string_view(icu_locale.getName());
+	serialize_simple_options(w, *this);
+
+	w & uint32_t(prefixes.end() - prefixes.begin());
+	for (auto& x : prefixes)
+		w & x;
+	w & uint32_t(suffixes.end() - suffixes.begin());
+	for (auto& x : suffixes)
+		w & x;
+	w & compound_rules.data();
+
+	// The tables below are written in the form they are constructed from,
+	// with the start and end markers put back.
+	auto break_patterns = vector<string>();
+	for (auto& x : break_table.start_word_breaks())
+		break_patterns.push_back('^' + x);
+	for (auto& x : break_table.end_word_breaks())
+		break_patterns.push_back(x + '$');
+	for (auto& x : break_table.middle_word_breaks())
+		break_patterns.push_back(x);
+	w & break_patterns;
+	w & input_substr_replacer.data() & output_substr_replacer.data();
+
+	auto reps = vector<pair<string, string>>();
+	for (auto& x : replacements.whole_word_replacements())
+		reps.emplace_back('^' + x.first + '$', x.second);
+	for (auto& x : replacements.start_word_replacements())
+		reps.emplace_back('^' + x.first, x.second);
+	for (auto& x : replacements.end_word_replacements())
+		reps.emplace_back(x.first + '$', x.second);
+	for (auto& x : replacements.any_place_replacements())
+		reps.push_back(x);
+	w & reps;
+
+	// The words are written as arrays that load_compiled() can view in
+	// place: the elements of the perfect hash table, with offsets into the
+	// bytes of the keys and indexes of the flag sets, the other tables of
+	// the perfect hash function, the blocks of the Bloom filter and the
+	// bytes of the keys. The capacity of the ordinary hash table is stored
+	// too, so unfreezing gives the same layout and iteration order.
+	auto frozen_copy = Word_List();
+	auto list = &words;
+	if (!words.is_frozen()) {
+		frozen_copy = words;
+		frozen_copy.freeze();
+		list = &frozen_copy;
+	}
+	auto tables = Word_List::Frozen_Table::Tables();
+	if (list->is_frozen())
+		tables = list->frozen_data().tables();
+	auto& blocks = list->get_filter().get_blocks();
+
+	auto& flag_sets = list->distinct_flag_sets();
+	auto flag_set_idx = unordered_map<const Flag_Set*, uint32_t>();
+	w & uint32_t(flag_sets.size());
+	for (auto& f : flag_sets) {
+		flag_set_idx.emplace(&f, flag_set_idx.size());
+		w & f;
+	}
+	// Equal keys are adjacent and stored once.
+	auto key_bytes = string();
+	auto key_offsets = vector<uint32_t>();
+	for (size_t i = 0; i != list->bucket_count(); ++i) {
+		for (auto& x : list->bucket_data(i)) {
+			auto prev = string_view(key_bytes).substr(
+			    key_offsets.empty() ? 0 : key_offsets.back());
+			if (!key_offsets.empty() && x.first == prev) {
+				key_offsets.push_back(key_offsets.back());
+				continue;
+			}
+			if (key_bytes.size() > UINT32_MAX - x.first.size())
+				return false;
+			key_offsets.push_back(key_bytes.size());
+			key_bytes += x.first;
+		}
+	}
+	w & uint64_t(list->capacity()) & uint64_t(list->size()) &
+	    uint64_t(tables.slots.size()) & uint64_t(tables.pilots.size()) &
+	    uint64_t(tables.num_positions) & uint64_t(blocks.size()) &
+	    uint64_t(key_bytes.size()) & compiled_hash_check();
+	w.pad_to(4);
+	auto j = size_t(0);
+	for (size_t i = 0; i != list->bucket_count(); ++i) {
+		for (auto& x : list->bucket_data(i))
+			w & key_offsets[j++] & uint32_t(x.first.size()) &
+			    flag_set_idx[x.second];
+	}
+	for (auto& x : tables.slots)
+		w & x.first & x.count & x.fingerprint;
+	for (auto x : tables.pilots)
+		w & x;
+	for (auto x : tables.remap)
+		w & x;
+	w.pad_to(alignof(Bloom_Filter::Block));
+	for (auto& b : blocks)
+		for (auto x : b.words)
+			w & x;
+	w.put_bytes(key_bytes);
+	return w.good();
+}
+
+/**
+ * @internal
+ * @brief Loads dictionary previously written with save_compiled().
+ *
+ * The small tables and the distinct flag sets are decoded. The keys, the
+ * tables of the perfect hash function and the Bloom filter of the word list
+ * are viewed in place, and the only work per word is filling the elements of
+ * the table with views of the keys. This requires @p owner, a little endian
+ * machine and the std::hash the file was written with. Otherwise the word
+ * list is rebuilt from the file and frozen.
+ *
+ * @param data the whole content of the compiled file
+ * @param owner owner of @p data, the word list keeps it alive, can be null
+ * @return true on success, false if the data is not a valid compiled
+ * dictionary of the current version
+ */
+auto Aff_Data::load_compiled(std::string_view data,
+                             std::shared_ptr<const void> owner) -> bool
+{
+	using Tables = Word_List::Frozen_Table::Tables;
+	using Slot = Word_List::Frozen_Table::Slot;
+	using Block = Bloom_Filter::Block;
+	static_assert(sizeof(Slot) == 8 && sizeof(Block) == 64);
+
+	if (data.substr(0, COMPILED_MAGIC.size()) != COMPILED_MAGIC)
+		return false;
+	auto r = Compiled_Reader(data);
+	r.get_bytes(COMPILED_MAGIC.size());
+	auto version = uint32_t();
+	r & version;
+	if (version != COMPILED_VERSION)
+		return false;
+	icu_locale = icu::Locale(string(r.get_view()).c_str());
+	serialize_simple_options(r, *this);
+
+	auto prefixes = vector<Prefix>();
+	auto suffixes = vector<Suffix>();
+	auto rules = vector<u16string>();
+	auto break_patterns = vector<string>();
+	auto input_conversion = vector<pair<string, string>>();
+	auto output_conversion = vector<pair<string, string>>();
+	auto replacements = vector<pair<string, string>>();
+	try {
+		r & prefixes & suffixes;
+	}
+	catch (const Condition_Exception&) {
+		return false;
+	}
+	r & rules & break_patterns & input_conversion & output_conversion &
+	    replacements;
+	auto flag_sets = vector<Flag_Set>();
+	r & flag_sets;
+	auto capacity = uint64_t();
+	auto word_count = uint64_t();
+	auto num_keys = uint64_t();
+	auto num_pilots = uint64_t();
+	auto num_positions = uint64_t();
+	auto num_blocks = uint64_t();
+	auto keys_size = uint64_t();
+	auto hash_check = uint64_t();
+	r & capacity & word_count & num_keys & num_pilots & num_positions &
+	    num_blocks & keys_size & hash_check;
+	// A capacity much larger than the file can only come from a corrupted
+	// file, reject it before it is allocated by unfreezing.
+	auto max_capacity = max(uint64_t(1) << 20, 8 * uint64_t(data.size()));
+	if (!r.good() || (capacity & (capacity - 1)) != 0 ||
+	    capacity > max_capacity || word_count > capacity ||
+	    num_keys > num_positions)
+		return false;
+	auto entries = r.get_array(word_count, 12, 4);
+	auto slot_bytes = r.get_array(num_keys, sizeof(Slot), 4);
+	auto pilot_bytes = r.get_array(num_pilots, 4, 4);
+	auto remap_bytes = r.get_array(num_positions - num_keys, 4, 4);
+	auto block_bytes =
+	    r.get_array(num_blocks, sizeof(Block), alignof(Block));
+	auto keys = r.get_bytes(keys_size);
+	if (!r.good() || !r.at_end() || !validate_utf8(keys))
+		return false;
+
+	auto role_flags = get_role_flags();
+	for (auto& x : prefixes)
+		x.cont_flags.assign_roles(role_flags);
+	for (auto& x : suffixes)
+		x.cont_flags.assign_roles(role_flags);
+	auto new_words = Word_List();
+	new_words.set_role_flags(role_flags);
+	auto flag_set_ptrs = vector<const Flag_Set_With_Roles*>();
+	for (auto& f : flag_sets)
+		flag_set_ptrs.push_back(new_words.intern(f));
+
+	// The keys must start and end at boundaries of code points.
+	auto is_boundary = [&](size_t i) {
+		return i == keys.size() ||
+		       (static_cast<unsigned char>(keys[i]) & 0xC0) != 0x80;
+	};
+	auto get_entry = [&](size_t i, string_view& key,
+	                     const Flag_Set_With_Roles*& flags) {
+		auto p = entries.data() + 12 * i;
+		auto offset = read_u32_le(p);
+		auto size = read_u32_le(p + 4);
+		auto idx = read_u32_le(p + 8);
+		if (offset > keys.size() || size > keys.size() - offset ||
+		    !is_boundary(offset) || !is_boundary(offset + size) ||
+		    idx >= flag_set_ptrs.size())
+			return false;
+		key = keys.substr(offset, size);
+		flags = flag_set_ptrs[idx];
+		return true;
+	};
+	auto key = string_view();
+	auto flags = static_cast<const Flag_Set_With_Roles*>(nullptr);
+	auto in_place = owner && is_little_endian() && num_keys != 0 &&
+	                hash_check == compiled_hash_check();
+	if (in_place) {
+		auto elements = vector<Word_List::value_type>();
+		elements.reserve(word_count);
+		for (size_t i = 0; i != word_count; ++i) {
+			if (!get_entry(i, key, flags))
+				return false;
+			elements.emplace_back(key, flags);
+		}
+		auto t = Tables();
+		t.slots = view_or_copy<Slot>(slot_bytes);
+		t.pilots = view_or_copy<uint32_t>(pilot_bytes);
+		t.remap = view_or_copy<uint32_t>(remap_bytes);
+		t.num_positions = num_positions;
+		auto table = Word_List::Frozen_Table();
+		if (!table.assign(move(elements), move(t)))
+			return false;
+		auto filter = Bloom_Filter(view_or_copy<Block>(block_bytes));
+		new_words.assign_frozen(move(table), capacity, move(filter),
+		                        move(owner));
+	}
+	else {
+		if (capacity != 0)
+			new_words.rehash(capacity - 1);
+		for (size_t i = 0; i != word_count; ++i) {
+			if (!get_entry(i, key, flags))
+				return false;
+			new_words.emplace_interned(key, flags);
+		}
+		new_words.freeze();
+		new_words.build_filter();
+	}
+
+	words = move(new_words);
+	this->prefixes = move(prefixes);
+	this->suffixes = move(suffixes);
+	compound_rules = move(rules);
+	break_table = move(break_patterns);
+	input_substr_replacer = move(input_conversion);
+	output_substr_replacer = move(output_conversion);
+	this->replacements = move(replacements);
+	return true;
+}
+} // namespace v6
 } // namespace nuspell
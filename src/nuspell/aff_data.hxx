@@ -22,11 +22,13 @@
 #include "nuspell_export.h"
 #include "structures.hxx"
 
+#include <deque>
 #include <iosfwd>
+#include <memory>
 #include <unicode/locid.h>
 
 namespace nuspell {
-inline namespace v5 {
+inline namespace v6 {
 
 class Encoding {
 	std::string name;
@@ -77,15 +79,183 @@ enum class Flag_Type { SINGLE_CHAR, DOUBLE_CHAR, NUMBER, UTF8 };
  * @internal
  * @brief Map between words and word_flags.
  *
- * Flags are stored as part of the container. Maybe for the future flags should
- * be stored elsewhere (flag aliases) and this should store pointers.
+ * The keys are views into an arena owned by the container. The arena is a list
+ * of big chunks that are never reallocated so the views stay valid for the
+ * lifetime of the container, and entries with equal keys share the same
+ * characters. This avoids one allocation per word.
+ *
+ * The flags are interned. Each distinct flag set is stored only once in a
+ * pool owned by the container and the entries point to it. Real dictionaries
+ * have only a few thousand distinct flag sets (that is why the aliases AF
+ * exist) so this saves a lot of memory, and two entries have equal flags if
+ * and only if they point to the same flag set. The role masks of the flag sets
+ * are computed from the Role_Flags given with set_role_flags().
+ *
+ * When no more words will be added, the list can be frozen with freeze(). It
+ * then uses a Perfect_Hash_Multimap for the lookups instead of the Robin Hood
+ * table. Adding a word to a frozen list unfreezes it. The order of the words
+ * in the buckets is the same in both states.
+ *
+ * After loading, build_filter() builds a Bloom filter of the keys. The
+ * checker queries it with might_contain_hash() before looking up candidate
+ * roots, most of which are not in the list.
+ *
+ * A frozen list can also be assigned with assign_frozen() from tables and
+ * keys that are viewed in place, from a mapped compiled dictionary. The list
+ * then shares the ownership of the mapping.
  *
  * Does not store morphological data as is low priority feature and is out of
  * scope.
  */
-using Word_List = Hash_Multimap<std::string, Flag_Set>;
+class Word_List {
+      public:
+	using Table =
+	    Hash_Multimap<std::string_view, const Flag_Set_With_Roles*>;
+	using key_type = Table::key_type;
+	using mapped_type = Table::mapped_type;
+	using value_type = Table::value_type;
+	using size_type = Table::size_type;
+	using reference = Table::reference;
+	using const_reference = Table::const_reference;
+	using pointer = Table::pointer;
+	using const_pointer = Table::const_pointer;
+	using Frozen_Table =
+	    Perfect_Hash_Multimap<std::string_view, const Flag_Set_With_Roles*>;
+
+      private:
+	static constexpr size_t arena_chunk_size = 64 * 1024;
+	Table table;
+	Frozen_Table frozen_table;
+	size_t frozen_capacity = 0;
+	bool frozen = false;
+	std::vector<std::unique_ptr<char[]>> arena;
+	char* arena_free = nullptr;
+	size_t arena_free_size = 0;
+	std::deque<Flag_Set_With_Roles> flag_sets;
+	Hash_Multimap<std::u16string_view, const Flag_Set_With_Roles*>
+	    flag_sets_index;
+	Role_Flags role_flags;
+	Bloom_Filter filter;
+	std::shared_ptr<const void> storage; // of the viewed keys and tables
+
+	NUSPELL_EXPORT auto store_key(std::string_view key) -> std::string_view;
+	NUSPELL_EXPORT auto unfreeze() -> void;
+
+      public:
+	Word_List() = default;
+	NUSPELL_EXPORT Word_List(const Word_List& other);
+	NUSPELL_EXPORT Word_List(Word_List&& other) noexcept;
+	NUSPELL_EXPORT auto operator=(const Word_List& other) -> Word_List&;
+	NUSPELL_EXPORT auto operator=(Word_List&& other) noexcept
+	    -> Word_List&;
+
+	auto size() const noexcept
+	{
+		return frozen ? frozen_table.size() : table.size();
+	}
+	auto empty() const noexcept { return size() == 0; }
+	auto capacity() const noexcept
+	{
+		return frozen ? frozen_capacity : table.capacity();
+	}
+	auto rehash(size_t count)
+	{
+		if (frozen)
+			unfreeze();
+		table.rehash(count);
+	}
+	auto reserve(size_t count)
+	{
+		if (frozen)
+			unfreeze();
+		table.reserve(count);
+	}
+	NUSPELL_EXPORT auto freeze() -> bool;
+	auto is_frozen() const noexcept { return frozen; }
+
+	NUSPELL_EXPORT auto intern(const Flag_Set& flags)
+	    -> const Flag_Set_With_Roles*;
+	auto set_role_flags(const Role_Flags& r) -> void
+	{
+		role_flags = r;
+		for (auto& f : flag_sets)
+			f.assign_roles(r);
+	}
+	/**
+	 * @brief Adds a word with flags that are already interned.
+	 * @param key word
+	 * @param flags flag set returned by intern() of this list
+	 */
+	auto emplace_interned(std::string_view key,
+	                      const Flag_Set_With_Roles* flags)
+	{
+		if (frozen)
+			unfreeze();
+		auto [first, last] = table.equal_range(key);
+		auto k = first != last ? first->first : store_key(key);
+		if (!filter.empty() && first == last)
+			filter.insert(k);
+		return table.emplace(k, flags);
+	}
+	auto emplace(std::string_view key, const Flag_Set& flags)
+	{
+		return emplace_interned(key, intern(flags));
+	}
+	auto emplace(std::string_view key, std::u16string_view flags)
+	{
+		return emplace(key, Flag_Set(std::u16string(flags)));
+	}
+	auto equal_range(std::string_view key, size_t key_hash) const
+	{
+		if (frozen)
+			return frozen_table.equal_range(key, key_hash);
+		return table.equal_range(key, key_hash);
+	}
+	auto equal_range(std::string_view key) const
+	{
+		return equal_range(key, hash(key));
+	}
+	NUSPELL_EXPORT auto build_filter() -> void;
+	NUSPELL_EXPORT auto assign_frozen(Frozen_Table&& t, size_t capacity,
+	                                  Bloom_Filter&& f,
+	                                  std::shared_ptr<const void> owner)
+	    -> void;
+	/**
+	 * @brief Gets the perfect hash table, the list must be frozen.
+	 */
+	auto frozen_data() const -> const Frozen_Table& { return frozen_table; }
+	auto get_filter() const -> const Bloom_Filter& { return filter; }
+	static auto hash(std::string_view key) -> size_t
+	{
+		return Table::hasher()(key);
+	}
+	auto might_contain(std::string_view key) const
+	{
+		return filter.might_contain(key);
+	}
+	/**
+	 * @brief Queries the Bloom filter with a precomputed hash.
+	 * @param key_hash hash of the key computed with hash()
+	 */
+	auto might_contain_hash(size_t key_hash) const
+	{
+		return filter.might_contain_hash(key_hash);
+	}
+	auto bucket_count() const
+	{
+		return frozen ? frozen_table.bucket_count()
+		              : table.bucket_count();
+	}
+	auto bucket_data(size_type i) const
+	{
+		if (frozen)
+			return frozen_table.bucket_data(i);
+		return table.bucket_data(i);
+	}
+	auto& distinct_flag_sets() const { return flag_sets; }
+};
 
-struct Aff_Data {
+struct NUSPELL_EXPORT Aff_Data {
 	static constexpr auto HIDDEN_HOMONYM_FLAG = char16_t(-1);
 	static constexpr auto MAX_SUGGESTIONS = size_t(16);
 
@@ -159,6 +329,7 @@ struct Aff_Data {
 	std::vector<Flag_Set> flag_aliases;
 	std::string wordchars; // deprecated?
 
+	auto get_role_flags() const -> Role_Flags;
 	auto parse_aff(std::istream& in) -> bool;
 	auto parse_dic(std::istream& in) -> bool;
 	auto parse_aff_dic(std::istream& aff, std::istream& dic)
@@ -167,7 +338,10 @@ struct Aff_Data {
 			return parse_dic(dic);
 		return false;
 	}
+	auto save_compiled(std::ostream& out) const -> bool;
+	auto load_compiled(std::string_view data,
+	                   std::shared_ptr<const void> owner) -> bool;
 };
-} // namespace v5
+} // namespace v6
 } // namespace nuspell
 #endif // NUSPELL_AFF_DATA_HXX
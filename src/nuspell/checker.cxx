@@ -23,7 +23,7 @@
 using namespace std;
 
 namespace nuspell {
-inline namespace v5 {
+inline namespace v6 {
 
 template <class L>
 class At_Scope_Exit {
@@ -47,8 +47,48 @@ class At_Scope_Exit {
 
 #define AT_SCOPE_EXIT(...) ASE_INTERNAL2(__COUNTER__, __VA_ARGS__)
 
+namespace {
+thread_local Lookup_Memo* active_lookup_memo = nullptr;
+thread_local Scratch_Pools* active_scratch_pools = nullptr;
+} // namespace
+
+/**
+ * @internal
+ * @brief Gets the Scratch_Pools installed by Scratch_Pools_Scope or the default
+ * ones of the thread.
+ */
+auto current_scratch_pools() -> Scratch_Pools&
+{
+	if (active_scratch_pools)
+		return *active_scratch_pools;
+	thread_local auto default_pools = Scratch_Pools();
+	return default_pools;
+}
+
+Scratch_Pools_Scope::Scratch_Pools_Scope(Scratch_Pools& p)
+    : old(active_scratch_pools)
+{
+	active_scratch_pools = &p;
+}
+
+Scratch_Pools_Scope::~Scratch_Pools_Scope() { active_scratch_pools = old; }
+
+Lookup_Memo_Scope::Lookup_Memo_Scope(Lookup_Memo& memo)
+    : old(active_lookup_memo)
+{
+	active_lookup_memo = &memo;
+}
+
+Lookup_Memo_Scope::~Lookup_Memo_Scope() { active_lookup_memo = old; }
+
 auto Checker::spell_priv(string& s) const -> bool
 {
+	auto memo = Lookup_Memo();
+	auto outer_memo = active_lookup_memo;
+	if (!outer_memo)
+		active_lookup_memo = &memo;
+	AT_SCOPE_EXIT(active_lookup_memo = outer_memo);
+
 	// do input conversion (iconv)
 	input_substr_replacer.replace(s);
 
@@ -75,7 +115,11 @@ auto Checker::spell_priv(string& s) const -> bool
 	erase_chars(s, ignored_chars);
 
 	// handle break patterns
-	auto copy = s;
+#ifndef NDEBUG
+	auto copy_buf = Scratch<string>();
+	auto& copy = *copy_buf;
+	copy = s;
+#endif
 	auto ret = spell_break(s);
 	assert(s == copy);
 	if (!ret && abbreviation) {
@@ -91,10 +135,10 @@ auto Checker::spell_break(std::string& s, size_t depth) const -> bool
 	auto res = spell_casing(s);
 	if (res) {
 		// handle forbidden words
-		if (res->contains(forbiddenword_flag)) {
+		if (res->roles & ROLE_FORBIDDENWORD) {
 			return false;
 		}
-		if (forbid_warn && res->contains(warn_flag)) {
+		if (forbid_warn && (res->roles & ROLE_WARN)) {
 			return false;
 		}
 		return true;
@@ -102,10 +146,13 @@ auto Checker::spell_break(std::string& s, size_t depth) const -> bool
 	if (depth == 9)
 		return false;
 
+	auto substr_buf = Scratch<string>();
+	auto& substr = *substr_buf;
+
 	// handle break pattern at start of a word
 	for (auto& pat : break_table.start_word_breaks()) {
 		if (begins_with(s, pat)) {
-			auto substr = s.substr(pat.size());
+			substr.assign(s, pat.size());
 			auto res = spell_break(substr, depth + 1);
 			if (res)
 				return res;
@@ -115,7 +162,7 @@ auto Checker::spell_break(std::string& s, size_t depth) const -> bool
 	// handle break pattern at end of a word
 	for (auto& pat : break_table.end_word_breaks()) {
 		if (ends_with(s, pat)) {
-			auto substr = s.substr(0, s.size() - pat.size());
+			substr.assign(s, 0, s.size() - pat.size());
 			auto res = spell_break(substr, depth + 1);
 			if (res)
 				return res;
@@ -126,12 +173,12 @@ auto Checker::spell_break(std::string& s, size_t depth) const -> bool
 	for (auto& pat : break_table.middle_word_breaks()) {
 		auto i = s.find(pat);
 		if (i > 0 && i < s.size() - pat.size()) {
-			auto part1 = s.substr(0, i);
-			auto part2 = s.substr(i + pat.size());
-			auto res1 = spell_break(part1, depth + 1);
+			substr.assign(s, 0, i);
+			auto res1 = spell_break(substr, depth + 1);
 			if (!res1)
 				continue;
-			auto res2 = spell_break(part2, depth + 1);
+			substr.assign(s, i + pat.size());
+			auto res2 = spell_break(substr, depth + 1);
 			if (res2)
 				return res2;
 		}
@@ -140,10 +187,11 @@ auto Checker::spell_break(std::string& s, size_t depth) const -> bool
 	return false;
 }
 
-auto Checker::spell_casing(std::string& s) const -> const Flag_Set*
+auto Checker::spell_casing(std::string& s) const
+    -> const Flag_Set_With_Roles*
 {
 	auto casing_type = classify_casing(s);
-	const Flag_Set* res = nullptr;
+	const Flag_Set_With_Roles* res = nullptr;
 
 	switch (casing_type) {
 	case Casing::SMALL:
@@ -161,7 +209,8 @@ auto Checker::spell_casing(std::string& s) const -> const Flag_Set*
 	return res;
 }
 
-auto Checker::spell_casing_upper(std::string& s) const -> const Flag_Set*
+auto Checker::spell_casing_upper(std::string& s) const
+    -> const Flag_Set_With_Roles*
 {
 	auto& loc = icu_locale;
 
@@ -171,24 +220,30 @@ auto Checker::spell_casing_upper(std::string& s) const -> const Flag_Set*
 
 	// handle prefixes separated by apostrophe for Catalan, French and
 	// Italian, e.g. SANT'ELIA -> Sant'+Elia
+	auto s2_buf = Scratch<string>();
+	auto& s2 = *s2_buf;
 	auto apos = s.find('\'');
 	if (apos != s.npos && apos != s.size() - 1) {
 		// apostophe is at beginning of word or dividing the word
-		auto part1 = s.substr(0, apos + 1);
-		auto part2 = s.substr(apos + 1);
-		to_lower(part1, loc, part1);
-		to_title(part2, loc, part2);
-		auto t = part1 + part2;
+		auto part1_buf = Scratch<string>();
+		auto part2_buf = Scratch<string>();
+		auto& part1 = *part1_buf;
+		auto& part2 = *part2_buf;
+		auto& t = s2;
+		to_lower(string_view(s).substr(0, apos + 1), loc, part1);
+		to_title(string_view(s).substr(apos + 1), loc, part2);
+		t = part1;
+		t += part2;
 		res = check_word(t, ALLOW_BAD_FORCEUCASE);
 		if (res)
 			return res;
 		to_title(part1, loc, part1);
-		t = part1 + part2;
+		t = part1;
+		t += part2;
 		res = check_word(t, ALLOW_BAD_FORCEUCASE);
 		if (res)
 			return res;
 	}
-	auto s2 = string();
 
 	// handle sharp s for German
 	if (checksharps && s.find("SS") != s.npos) {
@@ -204,17 +259,18 @@ auto Checker::spell_casing_upper(std::string& s) const -> const Flag_Set*
 	}
 	to_title(s, loc, s2);
 	res = check_word(s2, ALLOW_BAD_FORCEUCASE);
-	if (res && !res->contains(keepcase_flag))
+	if (res && !(res->roles & ROLE_KEEPCASE))
 		return res;
 
 	to_lower(s, loc, s2);
 	res = check_word(s2, ALLOW_BAD_FORCEUCASE);
-	if (res && !res->contains(keepcase_flag))
+	if (res && !(res->roles & ROLE_KEEPCASE))
 		return res;
 	return nullptr;
 }
 
-auto Checker::spell_casing_title(std::string& s) const -> const Flag_Set*
+auto Checker::spell_casing_title(std::string& s) const
+    -> const Flag_Set_With_Roles*
 {
 	auto& loc = icu_locale;
 
@@ -223,12 +279,13 @@ auto Checker::spell_casing_title(std::string& s) const -> const Flag_Set*
 	if (res)
 		return res;
 
-	auto s2 = string();
+	auto s2_buf = Scratch<string>();
+	auto& s2 = *s2_buf;
 	to_lower(s, loc, s2);
 	res = check_word(s2, ALLOW_BAD_FORCEUCASE);
 
 	// with CHECKSHARPS, ß is allowed too in KEEPCASE words with title case
-	if (res && res->contains(keepcase_flag) &&
+	if (res && (res->roles & ROLE_KEEPCASE) &&
 	    !(checksharps && (s2.find("ß") != s.npos))) {
 		res = nullptr;
 	}
@@ -253,7 +310,7 @@ auto Checker::spell_casing_title(std::string& s) const -> const Flag_Set*
  * @return The flags of the corresponding dictionary word.
  */
 auto Checker::spell_sharps(std::string& base, size_t pos, size_t n,
-                           size_t rep) const -> const Flag_Set*
+                           size_t rep) const -> const Flag_Set_With_Roles*
 {
 	const size_t MAX_SHARPS = 5;
 	pos = base.find("ss", pos);
@@ -275,7 +332,7 @@ auto Checker::spell_sharps(std::string& base, size_t pos, size_t n,
 
 auto Checker::check_word(std::string& s, Forceucase allow_bad_forceucase,
                          Hidden_Homonym skip_hidden_homonym) const
-    -> const Flag_Set*
+    -> const Flag_Set_With_Roles*
 {
 
 	auto ret1 = check_simple_word(s, skip_hidden_homonym);
@@ -283,78 +340,106 @@ auto Checker::check_word(std::string& s, Forceucase allow_bad_forceucase,
 		return ret1;
 	auto ret2 = check_compound(s, allow_bad_forceucase);
 	if (ret2)
-		return &ret2->second;
+		return ret2->second;
 
 	return nullptr;
 }
 
+/**
+ * @internal
+ * @brief Looks up a word in the word list.
+ *
+ * Queries the Bloom filter first. Inside spell_priv() the results are cached
+ * for the duration of the call.
+ *
+ * @param word word
+ * @return range of the word list entries with key @p word
+ */
+auto Checker::find_word(std::string_view word) const
+    -> std::pair<Word_List::const_pointer, Word_List::const_pointer>
+{
+	auto hash = words.hash(word);
+	auto memo = active_lookup_memo;
+	if (memo) {
+		auto cached = memo->find(word, hash);
+		if (cached)
+			return *cached;
+	}
+	auto range = Lookup_Memo::Range();
+	if (words.might_contain_hash(hash))
+		range = words.equal_range(word, hash);
+	if (memo)
+		memo->insert(word, hash, range);
+	return range;
+}
+
 auto Checker::check_simple_word(std::string& s,
                                 Hidden_Homonym skip_hidden_homonym) const
-    -> const Flag_Set*
+    -> const Flag_Set_With_Roles*
 {
-	for (auto& we : Subrange(words.equal_range(s))) {
-		auto& word_flags = we.second;
-		if (word_flags.contains(need_affix_flag))
+	for (auto& we : Subrange(find_word(s))) {
+		auto& word_flags = *we.second;
+		if (word_flags.roles & ROLE_NEEDAFFIX)
 			continue;
-		if (word_flags.contains(compound_onlyin_flag))
+		if (word_flags.roles & ROLE_ONLYINCOMPOUND)
 			continue;
 		if (skip_hidden_homonym &&
-		    word_flags.contains(HIDDEN_HOMONYM_FLAG))
+		    (word_flags.roles & ROLE_HIDDEN_HOMONYM))
 			continue;
 		return &word_flags;
 	}
 	{
 		auto ret3 = strip_suffix_only(s, skip_hidden_homonym);
 		if (ret3)
-			return &ret3->second;
+			return ret3->second;
 	}
 	{
 		auto ret2 = strip_prefix_only(s, skip_hidden_homonym);
 		if (ret2)
-			return &ret2->second;
+			return ret2->second;
 	}
 	{
 		auto ret4 = strip_prefix_then_suffix_commutative(
 		    s, skip_hidden_homonym);
 		if (ret4)
-			return &ret4->second;
+			return ret4->second;
 	}
 	if (!complex_prefixes) {
 		auto ret6 = strip_suffix_then_suffix(s, skip_hidden_homonym);
 		if (ret6)
-			return &ret6->second;
+			return ret6->second;
 
 		auto ret7 =
 		    strip_prefix_then_2_suffixes(s, skip_hidden_homonym);
 		if (ret7)
-			return &ret7->second;
+			return ret7->second;
 
 		auto ret8 = strip_suffix_prefix_suffix(s, skip_hidden_homonym);
 		if (ret8)
-			return &ret8->second;
+			return ret8->second;
 
 		// this is slow and unused so comment
 		// auto ret9 = strip_2_suffixes_then_prefix(s,
 		// skip_hidden_homonym); if (ret9)
-		//	return &ret9->second;
+		//	return ret9->second;
 	}
 	else {
 		auto ret6 = strip_prefix_then_prefix(s, skip_hidden_homonym);
 		if (ret6)
-			return &ret6->second;
+			return ret6->second;
 		auto ret7 =
 		    strip_suffix_then_2_prefixes(s, skip_hidden_homonym);
 		if (ret7)
-			return &ret7->second;
+			return ret7->second;
 
 		auto ret8 = strip_prefix_suffix_prefix(s, skip_hidden_homonym);
 		if (ret8)
-			return &ret8->second;
+			return ret8->second;
 
 		// this is slow and unused so comment
 		// auto ret9 = strip_2_prefixes_then_suffix(s,
 		// skip_hidden_homonym); if (ret9)
-		//	return &ret9->second;
+		//	return ret9->second;
 	}
 	return nullptr;
 }
@@ -374,16 +459,16 @@ class To_Root_Unroot_RAII {
 };
 
 template <Affixing_Mode m>
-auto Checker::is_valid_inside_compound(const Flag_Set& flags) const
+auto Checker::is_valid_inside_compound(const Flag_Set_With_Roles& flags) const
 {
-	if (m == AT_COMPOUND_BEGIN && !flags.contains(compound_flag) &&
-	    !flags.contains(compound_begin_flag))
+	if (m == AT_COMPOUND_BEGIN && !(flags.roles & ROLE_COMPOUNDFLAG) &&
+	    !(flags.roles & ROLE_COMPOUNDBEGIN))
 		return false;
-	if (m == AT_COMPOUND_MIDDLE && !flags.contains(compound_flag) &&
-	    !flags.contains(compound_middle_flag))
+	if (m == AT_COMPOUND_MIDDLE && !(flags.roles & ROLE_COMPOUNDFLAG) &&
+	    !(flags.roles & ROLE_COMPOUNDMIDDLE))
 		return false;
-	if (m == AT_COMPOUND_END && !flags.contains(compound_flag) &&
-	    !flags.contains(compound_last_flag))
+	if (m == AT_COMPOUND_END && !(flags.roles & ROLE_COMPOUNDFLAG) &&
+	    !(flags.roles & ROLE_COMPOUNDEND))
 		return false;
 	return true;
 }
@@ -399,8 +484,6 @@ auto Checker::strip_prefix_only(std::string& word,
                                 Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<Prefix>
 {
-	auto& dic = words;
-
 	for (auto it = prefixes.iterate_prefixes_of(word); it; ++it) {
 		auto& e = *it;
 		if (outer_affix_NOT_valid<m>(e))
@@ -410,16 +493,16 @@ auto Checker::strip_prefix_only(std::string& word,
 		To_Root_Unroot_RAII<Prefix> xxx(word, e);
 		if (!e.check_condition(word))
 			continue;
-		for (auto& word_entry : Subrange(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+		for (auto& word_entry : Subrange(find_word(word))) {
+			auto& word_flags = *word_entry.second;
 			if (!cross_valid_inner_outer(word_flags, e))
 				continue;
 			// badflag check
 			if (m == FULL_WORD &&
-			    word_flags.contains(compound_onlyin_flag))
+			    (word_flags.roles & ROLE_ONLYINCOMPOUND))
 				continue;
 			if (skip_hidden_homonym &&
-			    word_flags.contains(HIDDEN_HOMONYM_FLAG))
+			    (word_flags.roles & ROLE_HIDDEN_HOMONYM))
 				continue;
 			// needflag check
 			if (!is_valid_inside_compound<m>(word_flags) &&
@@ -442,29 +525,28 @@ auto Checker::strip_suffix_only(std::string& word,
                                 Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<Suffix>
 {
-	auto& dic = words;
 	for (auto it = suffixes.iterate_suffixes_of(word); it; ++it) {
 		auto& e = *it;
 		if (outer_affix_NOT_valid<m>(e))
 			continue;
 		if (e.appending.size() != 0 && m == AT_COMPOUND_END &&
-		    e.cont_flags.contains(compound_onlyin_flag))
+		    (e.cont_flags.roles & ROLE_ONLYINCOMPOUND))
 			continue;
 		if (is_circumfix(e))
 			continue;
 		To_Root_Unroot_RAII<Suffix> xxx(word, e);
 		if (!e.check_condition(word))
 			continue;
-		for (auto& word_entry : Subrange(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+		for (auto& word_entry : Subrange(find_word(word))) {
+			auto& word_flags = *word_entry.second;
 			if (!cross_valid_inner_outer(word_flags, e))
 				continue;
 			// badflag check
 			if (m == FULL_WORD &&
-			    word_flags.contains(compound_onlyin_flag))
+			    (word_flags.roles & ROLE_ONLYINCOMPOUND))
 				continue;
 			if (skip_hidden_homonym &&
-			    word_flags.contains(HIDDEN_HOMONYM_FLAG))
+			    (word_flags.roles & ROLE_HIDDEN_HOMONYM))
 				continue;
 			// needflag check
 			if (!is_valid_inside_compound<m>(word_flags) &&
@@ -513,8 +595,6 @@ auto Checker::strip_pfx_then_sfx_2(const Prefix& pe, std::string& word,
                                    Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<Suffix, Prefix>
 {
-	auto& dic = words;
-
 	for (auto it = suffixes.iterate_suffixes_of(word); it; ++it) {
 		auto& se = *it;
 		if (se.cross_product == false)
@@ -526,8 +606,8 @@ auto Checker::strip_pfx_then_sfx_2(const Prefix& pe, std::string& word,
 		To_Root_Unroot_RAII<Suffix> xxx(word, se);
 		if (!se.check_condition(word))
 			continue;
-		for (auto& word_entry : Subrange(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+		for (auto& word_entry : Subrange(find_word(word))) {
+			auto& word_flags = *word_entry.second;
 			if (!cross_valid_inner_outer(se, pe) &&
 			    !cross_valid_inner_outer(word_flags, pe))
 				continue;
@@ -535,10 +615,10 @@ auto Checker::strip_pfx_then_sfx_2(const Prefix& pe, std::string& word,
 				continue;
 			// badflag check
 			if (m == FULL_WORD &&
-			    word_flags.contains(compound_onlyin_flag))
+			    (word_flags.roles & ROLE_ONLYINCOMPOUND))
 				continue;
 			if (skip_hidden_homonym &&
-			    word_flags.contains(HIDDEN_HOMONYM_FLAG))
+			    (word_flags.roles & ROLE_HIDDEN_HOMONYM))
 				continue;
 			// needflag check
 			if (!is_valid_inside_compound<m>(word_flags) &&
@@ -589,8 +669,6 @@ auto Checker::strip_sfx_then_pfx_2(const Suffix& se, std::string& word,
                                    Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<Prefix, Suffix>
 {
-	auto& dic = words;
-
 	for (auto it = prefixes.iterate_prefixes_of(word); it; ++it) {
 		auto& pe = *it;
 		if (pe.cross_product == false)
@@ -602,8 +680,8 @@ auto Checker::strip_sfx_then_pfx_2(const Suffix& se, std::string& word,
 		To_Root_Unroot_RAII<Prefix> xxx(word, pe);
 		if (!pe.check_condition(word))
 			continue;
-		for (auto& word_entry : Subrange(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+		for (auto& word_entry : Subrange(find_word(word))) {
+			auto& word_flags = *word_entry.second;
 			if (!cross_valid_inner_outer(pe, se) &&
 			    !cross_valid_inner_outer(word_flags, se))
 				continue;
@@ -611,10 +689,10 @@ auto Checker::strip_sfx_then_pfx_2(const Suffix& se, std::string& word,
 				continue;
 			// badflag check
 			if (m == FULL_WORD &&
-			    word_flags.contains(compound_onlyin_flag))
+			    (word_flags.roles & ROLE_ONLYINCOMPOUND))
 				continue;
 			if (skip_hidden_homonym &&
-			    word_flags.contains(HIDDEN_HOMONYM_FLAG))
+			    (word_flags.roles & ROLE_HIDDEN_HOMONYM))
 				continue;
 			// needflag check
 			if (!is_valid_inside_compound<m>(word_flags) &&
@@ -654,8 +732,7 @@ auto Checker::strip_pfx_then_sfx_comm_2(
     const Prefix& pe, std::string& word,
     Hidden_Homonym skip_hidden_homonym) const -> Affixing_Result<Suffix, Prefix>
 {
-	auto& dic = words;
-	auto has_needaffix_pe = pe.cont_flags.contains(need_affix_flag);
+	auto has_needaffix_pe = bool(pe.cont_flags.roles & ROLE_NEEDAFFIX);
 	auto is_circumfix_pe = is_circumfix(pe);
 
 	for (auto it = suffixes.iterate_suffixes_of(word); it; ++it) {
@@ -664,7 +741,7 @@ auto Checker::strip_pfx_then_sfx_comm_2(
 			continue;
 		if (affix_NOT_valid<m>(se))
 			continue;
-		auto has_needaffix_se = se.cont_flags.contains(need_affix_flag);
+		auto has_needaffix_se = bool(se.cont_flags.roles & ROLE_NEEDAFFIX);
 		if (has_needaffix_pe && has_needaffix_se)
 			continue;
 		if (is_circumfix_pe != is_circumfix(se))
@@ -672,8 +749,8 @@ auto Checker::strip_pfx_then_sfx_comm_2(
 		To_Root_Unroot_RAII<Suffix> xxx(word, se);
 		if (!se.check_condition(word))
 			continue;
-		for (auto& word_entry : Subrange(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+		for (auto& word_entry : Subrange(find_word(word))) {
+			auto& word_flags = *word_entry.second;
 
 			auto valid_cross_pe_outer =
 			    !has_needaffix_pe &&
@@ -692,10 +769,10 @@ auto Checker::strip_pfx_then_sfx_comm_2(
 
 			// badflag check
 			if (m == FULL_WORD &&
-			    word_flags.contains(compound_onlyin_flag))
+			    (word_flags.roles & ROLE_ONLYINCOMPOUND))
 				continue;
 			if (skip_hidden_homonym &&
-			    word_flags.contains(HIDDEN_HOMONYM_FLAG))
+			    (word_flags.roles & ROLE_HIDDEN_HOMONYM))
 				continue;
 			// needflag check
 			if (!is_valid_inside_compound<m>(word_flags) &&
@@ -747,8 +824,6 @@ auto Checker::strip_sfx_then_sfx_2(const Suffix& se1, std::string& word,
     -> Affixing_Result<Suffix, Suffix>
 {
 
-	auto& dic = words;
-
 	for (auto it = suffixes.iterate_suffixes_of(word); it; ++it) {
 		auto& se2 = *it;
 		if (!cross_valid_inner_outer(se2, se1))
@@ -760,16 +835,16 @@ auto Checker::strip_sfx_then_sfx_2(const Suffix& se1, std::string& word,
 		To_Root_Unroot_RAII<Suffix> xxx(word, se2);
 		if (!se2.check_condition(word))
 			continue;
-		for (auto& word_entry : Subrange(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+		for (auto& word_entry : Subrange(find_word(word))) {
+			auto& word_flags = *word_entry.second;
 			if (!cross_valid_inner_outer(word_flags, se2))
 				continue;
 			// badflag check
 			if (m == FULL_WORD &&
-			    word_flags.contains(compound_onlyin_flag))
+			    (word_flags.roles & ROLE_ONLYINCOMPOUND))
 				continue;
 			if (skip_hidden_homonym &&
-			    word_flags.contains(HIDDEN_HOMONYM_FLAG))
+			    (word_flags.roles & ROLE_HIDDEN_HOMONYM))
 				continue;
 			// needflag check here if needed
 			return {word_entry, se2, se1};
@@ -814,8 +889,6 @@ auto Checker::strip_pfx_then_pfx_2(const Prefix& pe1, std::string& word,
                                    Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<Prefix, Prefix>
 {
-	auto& dic = words;
-
 	for (auto it = prefixes.iterate_prefixes_of(word); it; ++it) {
 		auto& pe2 = *it;
 		if (!cross_valid_inner_outer(pe2, pe1))
@@ -827,16 +900,16 @@ auto Checker::strip_pfx_then_pfx_2(const Prefix& pe1, std::string& word,
 		To_Root_Unroot_RAII<Prefix> xxx(word, pe2);
 		if (!pe2.check_condition(word))
 			continue;
-		for (auto& word_entry : Subrange(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+		for (auto& word_entry : Subrange(find_word(word))) {
+			auto& word_flags = *word_entry.second;
 			if (!cross_valid_inner_outer(word_flags, pe2))
 				continue;
 			// badflag check
 			if (m == FULL_WORD &&
-			    word_flags.contains(compound_onlyin_flag))
+			    (word_flags.roles & ROLE_ONLYINCOMPOUND))
 				continue;
 			if (skip_hidden_homonym &&
-			    word_flags.contains(HIDDEN_HOMONYM_FLAG))
+			    (word_flags.roles & ROLE_HIDDEN_HOMONYM))
 				continue;
 			// needflag check here if needed
 			return {word_entry, pe2, pe1};
@@ -896,8 +969,6 @@ auto Checker::strip_pfx_2_sfx_3(const Prefix& pe1, const Suffix& se1,
                                 Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<>
 {
-	auto& dic = words;
-
 	for (auto it = suffixes.iterate_suffixes_of(word); it; ++it) {
 		auto& se2 = *it;
 		if (!cross_valid_inner_outer(se2, se1))
@@ -909,8 +980,8 @@ auto Checker::strip_pfx_2_sfx_3(const Prefix& pe1, const Suffix& se1,
 		To_Root_Unroot_RAII<Suffix> xxx(word, se2);
 		if (!se2.check_condition(word))
 			continue;
-		for (auto& word_entry : Subrange(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+		for (auto& word_entry : Subrange(find_word(word))) {
+			auto& word_flags = *word_entry.second;
 			if (!cross_valid_inner_outer(se1, pe1) &&
 			    !cross_valid_inner_outer(word_flags, pe1))
 				continue;
@@ -918,10 +989,10 @@ auto Checker::strip_pfx_2_sfx_3(const Prefix& pe1, const Suffix& se1,
 				continue;
 			// badflag check
 			if (m == FULL_WORD &&
-			    word_flags.contains(compound_onlyin_flag))
+			    (word_flags.roles & ROLE_ONLYINCOMPOUND))
 				continue;
 			if (skip_hidden_homonym &&
-			    word_flags.contains(HIDDEN_HOMONYM_FLAG))
+			    (word_flags.roles & ROLE_HIDDEN_HOMONYM))
 				continue;
 			// needflag check here if needed
 			return {word_entry};
@@ -982,8 +1053,6 @@ auto Checker::strip_s_p_s_3(const Suffix& se1, const Prefix& pe1,
                             Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<>
 {
-	auto& dic = words;
-
 	for (auto it = suffixes.iterate_suffixes_of(word); it; ++it) {
 		auto& se2 = *it;
 		if (se2.cross_product == false)
@@ -1002,8 +1071,8 @@ auto Checker::strip_s_p_s_3(const Suffix& se1, const Prefix& pe1,
 		To_Root_Unroot_RAII<Suffix> xxx(word, se2);
 		if (!se2.check_condition(word))
 			continue;
-		for (auto& word_entry : Subrange(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+		for (auto& word_entry : Subrange(find_word(word))) {
+			auto& word_flags = *word_entry.second;
 			if (!cross_valid_inner_outer(se2, pe1) &&
 			    !cross_valid_inner_outer(word_flags, pe1))
 				continue;
@@ -1011,10 +1080,10 @@ auto Checker::strip_s_p_s_3(const Suffix& se1, const Prefix& pe1,
 				continue;
 			// badflag check
 			if (m == FULL_WORD &&
-			    word_flags.contains(compound_onlyin_flag))
+			    (word_flags.roles & ROLE_ONLYINCOMPOUND))
 				continue;
 			if (skip_hidden_homonym &&
-			    word_flags.contains(HIDDEN_HOMONYM_FLAG))
+			    (word_flags.roles & ROLE_HIDDEN_HOMONYM))
 				continue;
 			// needflag check here if needed
 			return {word_entry};
@@ -1075,8 +1144,6 @@ auto Checker::strip_2_sfx_pfx_3(const Suffix& se1, const Suffix& se2,
                                 Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<>
 {
-	auto& dic = words;
-
 	for (auto it = prefixes.iterate_prefixes_of(word); it; ++it) {
 		auto& pe1 = *it;
 		if (pe1.cross_product == false)
@@ -1091,8 +1158,8 @@ auto Checker::strip_2_sfx_pfx_3(const Suffix& se1, const Suffix& se2,
 		To_Root_Unroot_RAII<Prefix> xxx(word, pe1);
 		if (!pe1.check_condition(word))
 			continue;
-		for (auto& word_entry : Subrange(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+		for (auto& word_entry : Subrange(find_word(word))) {
+			auto& word_flags = *word_entry.second;
 			if (!cross_valid_inner_outer(pe1, se2) &&
 			    !cross_valid_inner_outer(word_flags, se2))
 				continue;
@@ -1100,10 +1167,10 @@ auto Checker::strip_2_sfx_pfx_3(const Suffix& se1, const Suffix& se2,
 				continue;
 			// badflag check
 			if (m == FULL_WORD &&
-			    word_flags.contains(compound_onlyin_flag))
+			    (word_flags.roles & ROLE_ONLYINCOMPOUND))
 				continue;
 			if (skip_hidden_homonym &&
-			    word_flags.contains(HIDDEN_HOMONYM_FLAG))
+			    (word_flags.roles & ROLE_HIDDEN_HOMONYM))
 				continue;
 			// needflag check here if needed
 			return {word_entry};
@@ -1164,8 +1231,6 @@ auto Checker::strip_sfx_2_pfx_3(const Suffix& se1, const Prefix& pe1,
                                 Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<>
 {
-	auto& dic = words;
-
 	for (auto it = prefixes.iterate_prefixes_of(word); it; ++it) {
 		auto& pe2 = *it;
 		if (!cross_valid_inner_outer(pe2, pe1))
@@ -1177,8 +1242,8 @@ auto Checker::strip_sfx_2_pfx_3(const Suffix& se1, const Prefix& pe1,
 		To_Root_Unroot_RAII<Prefix> xxx(word, pe2);
 		if (!pe2.check_condition(word))
 			continue;
-		for (auto& word_entry : Subrange(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+		for (auto& word_entry : Subrange(find_word(word))) {
+			auto& word_flags = *word_entry.second;
 			if (!cross_valid_inner_outer(pe1, se1) &&
 			    !cross_valid_inner_outer(word_flags, se1))
 				continue;
@@ -1186,10 +1251,10 @@ auto Checker::strip_sfx_2_pfx_3(const Suffix& se1, const Prefix& pe1,
 				continue;
 			// badflag check
 			if (m == FULL_WORD &&
-			    word_flags.contains(compound_onlyin_flag))
+			    (word_flags.roles & ROLE_ONLYINCOMPOUND))
 				continue;
 			if (skip_hidden_homonym &&
-			    word_flags.contains(HIDDEN_HOMONYM_FLAG))
+			    (word_flags.roles & ROLE_HIDDEN_HOMONYM))
 				continue;
 			return {word_entry};
 		}
@@ -1249,8 +1314,6 @@ auto Checker::strip_p_s_p_3(const Prefix& pe1, const Suffix& se1,
                             Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<>
 {
-	auto& dic = words;
-
 	for (auto it = prefixes.iterate_prefixes_of(word); it; ++it) {
 		auto& pe2 = *it;
 		if (pe2.cross_product == false)
@@ -1269,8 +1332,8 @@ auto Checker::strip_p_s_p_3(const Prefix& pe1, const Suffix& se1,
 		To_Root_Unroot_RAII<Prefix> xxx(word, pe2);
 		if (!pe2.check_condition(word))
 			continue;
-		for (auto& word_entry : Subrange(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+		for (auto& word_entry : Subrange(find_word(word))) {
+			auto& word_flags = *word_entry.second;
 			if (!cross_valid_inner_outer(pe2, se1) &&
 			    !cross_valid_inner_outer(word_flags, se1))
 				continue;
@@ -1278,10 +1341,10 @@ auto Checker::strip_p_s_p_3(const Prefix& pe1, const Suffix& se1,
 				continue;
 			// badflag check
 			if (m == FULL_WORD &&
-			    word_flags.contains(compound_onlyin_flag))
+			    (word_flags.roles & ROLE_ONLYINCOMPOUND))
 				continue;
 			if (skip_hidden_homonym &&
-			    word_flags.contains(HIDDEN_HOMONYM_FLAG))
+			    (word_flags.roles & ROLE_HIDDEN_HOMONYM))
 				continue;
 			return {word_entry};
 		}
@@ -1341,8 +1404,6 @@ auto Checker::strip_2_pfx_sfx_3(const Prefix& pe1, const Prefix& pe2,
                                 Hidden_Homonym skip_hidden_homonym) const
     -> Affixing_Result<>
 {
-	auto& dic = words;
-
 	for (auto it = suffixes.iterate_suffixes_of(word); it; ++it) {
 		auto& se1 = *it;
 		if (se1.cross_product == false)
@@ -1357,8 +1418,8 @@ auto Checker::strip_2_pfx_sfx_3(const Prefix& pe1, const Prefix& pe2,
 		To_Root_Unroot_RAII<Suffix> xxx(word, se1);
 		if (!se1.check_condition(word))
 			continue;
-		for (auto& word_entry : Subrange(dic.equal_range(word))) {
-			auto& word_flags = word_entry.second;
+		for (auto& word_entry : Subrange(find_word(word))) {
+			auto& word_flags = *word_entry.second;
 			if (!cross_valid_inner_outer(se1, pe2) &&
 			    !cross_valid_inner_outer(word_flags, pe2))
 				continue;
@@ -1366,10 +1427,10 @@ auto Checker::strip_2_pfx_sfx_3(const Prefix& pe1, const Prefix& pe2,
 				continue;
 			// badflag check
 			if (m == FULL_WORD &&
-			    word_flags.contains(compound_onlyin_flag))
+			    (word_flags.roles & ROLE_ONLYINCOMPOUND))
 				continue;
 			if (skip_hidden_homonym &&
-			    word_flags.contains(HIDDEN_HOMONYM_FLAG))
+			    (word_flags.roles & ROLE_HIDDEN_HOMONYM))
 				continue;
 			return {word_entry};
 		}
@@ -1389,10 +1450,10 @@ auto match_compound_pattern(const Compound_Pattern& p, string_view word,
 	                 p.begin_end_chars.str()) != 0)
 		return false;
 	if (p.first_word_flag != 0 &&
-	    !first->second.contains(p.first_word_flag))
+	    !first->second->contains(p.first_word_flag))
 		return false;
 	if (p.second_word_flag != 0 &&
-	    !second->second.contains(p.second_word_flag))
+	    !second->second->contains(p.second_word_flag))
 		return false;
 	if (p.match_first_only_unaffixed_or_zero_affixed &&
 	    first.affixed_and_modified)
@@ -1414,7 +1475,8 @@ auto Checker::check_compound(std::string& word,
                              Forceucase allow_bad_forceucase) const
     -> Compounding_Result
 {
-	auto part = string();
+	auto part_buf = Scratch<string>();
+	auto& part = *part_buf;
 
 	if (compound_flag || compound_begin_flag || compound_middle_flag ||
 	    compound_last_flag) {
@@ -1424,8 +1486,9 @@ auto Checker::check_compound(std::string& word,
 			return ret;
 	}
 	if (!compound_rules.empty()) {
-		auto words_data = vector<const Flag_Set*>();
-		return check_compound_with_rules(word, words_data, 0, part,
+		auto words_data_buf = Scratch<vector<const Flag_Set*>>();
+		auto& words_data = *words_data_buf;
+		return check_compound_with_rules(word, words_data, 0,
 		                                 allow_bad_forceucase);
 	}
 
@@ -1501,7 +1564,7 @@ auto Checker::check_compound_classic(std::string& word, size_t start_pos,
 	auto part1_entry = check_word_in_compound<m>(part);
 	if (!part1_entry)
 		return {};
-	if (part1_entry->second.contains(forbiddenword_flag))
+	if (part1_entry->second->roles & ROLE_FORBIDDENWORD)
 		return {};
 	if (compound_check_triple) {
 		if (are_three_code_points_equal(word, i))
@@ -1512,13 +1575,13 @@ auto Checker::check_compound_classic(std::string& word, size_t start_pos,
 		return {};
 	num_part += part1_entry.num_words_modifier;
 	num_part += compound_root_flag &&
-	            part1_entry->second.contains(compound_root_flag);
+	            (part1_entry->second->roles & ROLE_COMPOUNDROOT);
 
 	part.assign(word, i, word.npos);
 	auto part2_entry = check_word_in_compound<AT_COMPOUND_END>(part);
 	if (!part2_entry)
 		goto try_recursive;
-	if (part2_entry->second.contains(forbiddenword_flag))
+	if (part2_entry->second->roles & ROLE_FORBIDDENWORD)
 		goto try_recursive;
 	if (is_compound_forbidden_by_patterns(compound_patterns, word, i,
 	                                      part1_entry, part2_entry))
@@ -1531,13 +1594,13 @@ auto Checker::check_compound_classic(std::string& word, size_t start_pos,
 			goto try_recursive;
 	}
 	if (compound_force_uppercase && !allow_bad_forceucase &&
-	    part2_entry->second.contains(compound_force_uppercase))
+	    (part2_entry->second->roles & ROLE_FORCEUCASE))
 		goto try_recursive;
 
 	old_num_part = num_part;
 	num_part += part2_entry.num_words_modifier;
 	num_part += compound_root_flag &&
-	            part2_entry->second.contains(compound_root_flag);
+	            (part2_entry->second->roles & ROLE_COMPOUNDROOT);
 	if (compound_max_word_count != 0 &&
 	    num_part + 1 >= compound_max_word_count) {
 		if (compound_syllable_vowels.empty()) // is not Hungarian
@@ -1595,7 +1658,7 @@ try_simplified_triple:
 	part2_entry = check_word_in_compound<AT_COMPOUND_END>(part);
 	if (!part2_entry)
 		goto try_simplified_triple_recursive;
-	if (part2_entry->second.contains(forbiddenword_flag))
+	if (part2_entry->second->roles & ROLE_FORBIDDENWORD)
 		goto try_simplified_triple_recursive;
 	if (is_compound_forbidden_by_patterns(compound_patterns, word, i,
 	                                      part1_entry, part2_entry))
@@ -1613,7 +1676,7 @@ try_simplified_triple:
 			goto try_simplified_triple_recursive;
 	}
 	if (compound_force_uppercase && !allow_bad_forceucase &&
-	    part2_entry->second.contains(compound_force_uppercase))
+	    (part2_entry->second->roles & ROLE_FORCEUCASE))
 		goto try_simplified_triple_recursive;
 
 	if (compound_max_word_count != 0 &&
@@ -1674,10 +1737,10 @@ auto Checker::check_compound_with_pattern_replacements(
 		auto part1_entry = check_word_in_compound<m>(part);
 		if (!part1_entry)
 			continue;
-		if (part1_entry->second.contains(forbiddenword_flag))
+		if (part1_entry->second->roles & ROLE_FORBIDDENWORD)
 			continue;
 		if (p.first_word_flag != 0 &&
-		    !part1_entry->second.contains(p.first_word_flag))
+		    !part1_entry->second->contains(p.first_word_flag))
 			continue;
 		if (compound_check_triple) {
 			if (are_three_code_points_equal(word, i))
@@ -1689,10 +1752,10 @@ auto Checker::check_compound_with_pattern_replacements(
 		    check_word_in_compound<AT_COMPOUND_END>(part);
 		if (!part2_entry)
 			goto try_recursive;
-		if (part2_entry->second.contains(forbiddenword_flag))
+		if (part2_entry->second->roles & ROLE_FORBIDDENWORD)
 			goto try_recursive;
 		if (p.second_word_flag != 0 &&
-		    !part2_entry->second.contains(p.second_word_flag))
+		    !part2_entry->second->contains(p.second_word_flag))
 			goto try_recursive;
 		if (compound_check_duplicate && part1_entry == part2_entry)
 			goto try_recursive;
@@ -1705,7 +1768,7 @@ auto Checker::check_compound_with_pattern_replacements(
 				goto try_recursive;
 		}
 		if (compound_force_uppercase && !allow_bad_forceucase &&
-		    part2_entry->second.contains(compound_force_uppercase))
+		    (part2_entry->second->roles & ROLE_FORCEUCASE))
 			goto try_recursive;
 
 		if (compound_max_word_count != 0 &&
@@ -1719,7 +1782,7 @@ auto Checker::check_compound_with_pattern_replacements(
 		if (!part2_entry)
 			goto try_simplified_triple;
 		if (p.second_word_flag != 0 &&
-		    !part2_entry->second.contains(p.second_word_flag))
+		    !part2_entry->second->contains(p.second_word_flag))
 			goto try_simplified_triple;
 		// if (compound_check_duplicate && part1_entry == part2_entry)
 		//	goto try_simplified_triple;
@@ -1757,10 +1820,10 @@ auto Checker::check_compound_with_pattern_replacements(
 		part2_entry = check_word_in_compound<AT_COMPOUND_END>(part);
 		if (!part2_entry)
 			goto try_simplified_triple_recursive;
-		if (part2_entry->second.contains(forbiddenword_flag))
+		if (part2_entry->second->roles & ROLE_FORBIDDENWORD)
 			goto try_simplified_triple_recursive;
 		if (p.second_word_flag != 0 &&
-		    !part2_entry->second.contains(p.second_word_flag))
+		    !part2_entry->second->contains(p.second_word_flag))
 			goto try_simplified_triple_recursive;
 		if (compound_check_duplicate && part1_entry == part2_entry)
 			goto try_simplified_triple_recursive;
@@ -1775,7 +1838,7 @@ auto Checker::check_compound_with_pattern_replacements(
 				goto try_simplified_triple_recursive;
 		}
 		if (compound_force_uppercase && !allow_bad_forceucase &&
-		    part2_entry->second.contains(compound_force_uppercase))
+		    (part2_entry->second->roles & ROLE_FORCEUCASE))
 			goto try_simplified_triple_recursive;
 
 		if (compound_max_word_count != 0 &&
@@ -1789,7 +1852,7 @@ auto Checker::check_compound_with_pattern_replacements(
 		if (!part2_entry)
 			continue;
 		if (p.second_word_flag != 0 &&
-		    !part2_entry->second.contains(p.second_word_flag))
+		    !part2_entry->second->contains(p.second_word_flag))
 			continue;
 		// if (compound_check_duplicate && part1_entry == part2_entry)
 		//	continue;
@@ -1827,23 +1890,23 @@ template <Affixing_Mode m>
 auto Checker::check_word_in_compound(std::string& word) const
     -> Compounding_Result
 {
-	auto cpd_flag = char16_t();
+	auto cpd_role = Flag_Role();
 	if (m == AT_COMPOUND_BEGIN)
-		cpd_flag = compound_begin_flag;
+		cpd_role = ROLE_COMPOUNDBEGIN;
 	else if (m == AT_COMPOUND_MIDDLE)
-		cpd_flag = compound_middle_flag;
+		cpd_role = ROLE_COMPOUNDMIDDLE;
 	else if (m == AT_COMPOUND_END)
-		cpd_flag = compound_last_flag;
+		cpd_role = ROLE_COMPOUNDEND;
 
-	auto range = words.equal_range(word);
+	auto range = find_word(word);
 	for (auto& we : Subrange(range)) {
-		auto& word_flags = we.second;
-		if (word_flags.contains(need_affix_flag))
+		auto& word_flags = *we.second;
+		if (word_flags.roles & ROLE_NEEDAFFIX)
 			continue;
-		if (!word_flags.contains(compound_flag) &&
-		    !word_flags.contains(cpd_flag))
+		if (!(word_flags.roles & ROLE_COMPOUNDFLAG) &&
+		    !(word_flags.roles & cpd_role))
 			continue;
-		if (word_flags.contains(HIDDEN_HOMONYM_FLAG))
+		if (word_flags.roles & ROLE_HIDDEN_HOMONYM)
 			continue;
 		auto num_syllable_mod = calc_syllable_modifier<m>(we);
 		return {&we, 0, num_syllable_mod};
@@ -1885,7 +1948,7 @@ auto Checker::calc_syllable_modifier(Word_List::const_reference we) const
 {
 	auto subtract_syllable =
 	    m == AT_COMPOUND_END && !compound_syllable_vowels.empty() &&
-	    we.second.contains('I') && !we.second.contains('J');
+	    we.second->contains('I') && !we.second->contains('J');
 	return 0 - subtract_syllable;
 }
 
@@ -1917,7 +1980,7 @@ auto Checker::calc_syllable_modifier(Word_List::const_reference we,
 			break;
 
 		case 'I':
-			num_syllable_mod += we.second.contains('J');
+			num_syllable_mod += we.second->contains('J');
 			break;
 		}
 	}
@@ -1930,8 +1993,8 @@ auto Checker::count_syllables(std::string_view word) const -> size_t
 }
 
 auto Checker::check_compound_with_rules(
-    std::string& word, std::vector<const Flag_Set*>& words_data,
-    size_t start_pos, std::string& part, Forceucase allow_bad_forceucase) const
+    std::string_view word, std::vector<const Flag_Set*>& words_data,
+    size_t start_pos, Forceucase allow_bad_forceucase) const
     -> Compounding_Result
 {
 	size_t min_num_cp = 3;
@@ -1951,12 +2014,12 @@ auto Checker::check_compound_with_rules(
 		valid_u8_reverse_index(word, last_i);
 	}
 	for (; i <= last_i; valid_u8_advance_index(word, i)) {
-		part.assign(word, start_pos, i - start_pos);
+		auto part1 = word.substr(start_pos, i - start_pos);
 		auto part1_entry = Word_List::const_pointer();
-		auto range = words.equal_range(part);
+		auto range = find_word(part1);
 		for (auto& we : Subrange(range)) {
-			auto& word_flags = we.second;
-			if (word_flags.contains(need_affix_flag))
+			auto& word_flags = *we.second;
+			if (word_flags.roles & ROLE_NEEDAFFIX)
 				continue;
 			if (!compound_rules.has_any_of_flags(word_flags))
 				continue;
@@ -1965,15 +2028,15 @@ auto Checker::check_compound_with_rules(
 		}
 		if (!part1_entry)
 			continue;
-		words_data.push_back(&part1_entry->second);
+		words_data.push_back(part1_entry->second);
 		AT_SCOPE_EXIT(words_data.pop_back());
 
-		part.assign(word, i, word.npos);
+		auto part2 = word.substr(i);
 		auto part2_entry = Word_List::const_pointer();
-		range = words.equal_range(part);
+		range = find_word(part2);
 		for (auto& we : Subrange(range)) {
-			auto& word_flags = we.second;
-			if (word_flags.contains(need_affix_flag))
+			auto& word_flags = *we.second;
+			if (word_flags.roles & ROLE_NEEDAFFIX)
 				continue;
 			if (!compound_rules.has_any_of_flags(word_flags))
 				continue;
@@ -1984,26 +2047,25 @@ auto Checker::check_compound_with_rules(
 			goto try_recursive;
 
 		{
-			words_data.push_back(&part2_entry->second);
+			words_data.push_back(part2_entry->second);
 			AT_SCOPE_EXIT(words_data.pop_back());
 
 			auto m = compound_rules.match_any_rule(words_data);
 			if (!m)
 				goto try_recursive;
 			if (compound_force_uppercase && !allow_bad_forceucase &&
-			    part2_entry->second.contains(
-			        compound_force_uppercase))
+			    (part2_entry->second->roles & ROLE_FORCEUCASE))
 				goto try_recursive;
 
 			return {part1_entry};
 		}
 	try_recursive:
-		part2_entry = check_compound_with_rules(
-		    word, words_data, i, part, allow_bad_forceucase);
+		part2_entry = check_compound_with_rules(word, words_data, i,
+		                                        allow_bad_forceucase);
 		if (part2_entry)
 			return {part2_entry};
 	}
 	return {};
 }
-} // namespace v5
+} // namespace v6
 } // namespace nuspell
@@ -21,8 +21,10 @@
 
 #include "aff_data.hxx"
 
+#include <tuple>
+
 namespace nuspell {
-inline namespace v5 {
+inline namespace v6 {
 
 enum Affixing_Mode {
 	FULL_WORD,
@@ -79,6 +81,173 @@ struct Compounding_Result {
 	auto operator->() const { return word_entry; }
 };
 
+struct Word_Entry_And_Score {
+	Word_List::const_pointer word_entry = {};
+	ptrdiff_t score = {};
+	auto operator<(const Word_Entry_And_Score& rhs) const
+	{
+		return score > rhs.score; // Greater than
+	}
+};
+struct Word_And_Score {
+	std::u32string word = {};
+	ptrdiff_t score = {};
+	auto operator<(const Word_And_Score& rhs) const
+	{
+		return score > rhs.score; // Greater than
+	}
+};
+
+/**
+ * @internal
+ * @brief Pools of reusable temporary buffers, see Scratch.
+ *
+ * Each thread has a default one. A Spell_Context given to Dictionary::spell()
+ * or Dictionary::suggest() owns another one that replaces it during the call.
+ */
+class Scratch_Pools {
+	std::tuple<std::vector<std::string>, std::vector<std::u32string>,
+	           std::vector<List_Strings>, std::vector<std::vector<bool>>,
+	           std::vector<std::vector<size_t>>,
+	           std::vector<std::vector<const Flag_Set*>>,
+	           std::vector<std::vector<Word_Entry_And_Score>>,
+	           std::vector<std::vector<Word_And_Score>>>
+	    pools;
+
+      public:
+	/**
+	 * @brief Gets the free buffers of type T.
+	 */
+	template <class T>
+	auto pool() -> std::vector<T>&
+	{
+		return std::get<std::vector<T>>(pools);
+	}
+};
+
+auto current_scratch_pools() -> Scratch_Pools&;
+
+/**
+ * @internal
+ * @brief Makes Scratch_Pools the current ones of the thread for its lifetime.
+ */
+class Scratch_Pools_Scope {
+	Scratch_Pools* old;
+
+      public:
+	explicit Scratch_Pools_Scope(Scratch_Pools& p);
+	~Scratch_Pools_Scope();
+	Scratch_Pools_Scope(const Scratch_Pools_Scope&) = delete;
+	auto operator=(const Scratch_Pools_Scope&)
+	    -> Scratch_Pools_Scope& = delete;
+};
+
+/**
+ * @internal
+ * @brief Small cache of Word_List lookups during one call of spell_priv().
+ *
+ * The strip functions and the casing variants look up the same candidate
+ * roots many times for one input word. It is direct-mapped by the hash of the
+ * key, a new key replaces the old one in its entry. The keys are copied into
+ * a fixed buffer and when it is full no new keys are stored.
+ *
+ * Which entries are used is tracked in a bit mask, so constructing the memo
+ * does not write the arrays.
+ */
+class Lookup_Memo {
+      public:
+	using Range =
+	    std::pair<Word_List::const_pointer, Word_List::const_pointer>;
+
+      private:
+	struct Entry {
+		size_t hash;
+		uint32_t key_pos;
+		uint32_t key_len;
+		Range range;
+	};
+	static constexpr size_t num_entries = 64;
+	static constexpr size_t buffer_size = 2048;
+	Entry entries[num_entries];
+	char buffer[buffer_size];
+	size_t buffer_used = 0;
+	uint64_t used_entries = 0;
+
+      public:
+	// User-provided, so value initialization does not zero the arrays.
+	Lookup_Memo() noexcept {}
+	auto find(std::string_view key, size_t hash) const -> const Range*
+	{
+		auto i = hash % num_entries;
+		auto& e = entries[i];
+		if ((used_entries >> i & 1) && e.hash == hash &&
+		    e.key_len == key.size() &&
+		    std::string_view(buffer + e.key_pos, e.key_len) == key)
+			return &e.range;
+		return nullptr;
+	}
+	auto insert(std::string_view key, size_t hash, const Range& range)
+	    -> void
+	{
+		if (key.size() > buffer_size - buffer_used)
+			return;
+		auto i = hash % num_entries;
+		std::copy(begin(key), end(key), buffer + buffer_used);
+		entries[i] = {hash, uint32_t(buffer_used), uint32_t(key.size()),
+		              range};
+		used_entries |= uint64_t(1) << i;
+		buffer_used += key.size();
+	}
+};
+
+/**
+ * @internal
+ * @brief Makes a Lookup_Memo the current one of the thread for its lifetime.
+ *
+ * spell_priv() installs its own memo only if there is no current one.
+ */
+class Lookup_Memo_Scope {
+	Lookup_Memo* old;
+
+      public:
+	NUSPELL_EXPORT explicit Lookup_Memo_Scope(Lookup_Memo& memo);
+	NUSPELL_EXPORT ~Lookup_Memo_Scope();
+	Lookup_Memo_Scope(const Lookup_Memo_Scope&) = delete;
+	auto operator=(const Lookup_Memo_Scope&)
+	    -> Lookup_Memo_Scope& = delete;
+};
+
+/**
+ * @internal
+ * @brief Temporary buffer taken from the current Scratch_Pools.
+ *
+ * The buffer is given back at the end of the scope and keeps its capacity.
+ * A single buffer per function would not be enough because the functions are
+ * recursive.
+ */
+template <class T>
+class Scratch {
+	std::vector<T>& pool;
+	T buf;
+
+      public:
+	Scratch() : pool(current_scratch_pools().pool<T>())
+	{
+		if (!pool.empty()) {
+			buf = std::move(pool.back());
+			pool.pop_back();
+		}
+	}
+	~Scratch()
+	{
+		buf.clear();
+		pool.push_back(std::move(buf));
+	}
+	Scratch(const Scratch&) = delete;
+	auto operator=(const Scratch&) -> Scratch& = delete;
+	auto operator*() -> T& { return buf; }
+};
+
 struct Checker : public Aff_Data {
 	enum Forceucase : bool {
 		FORBID_BAD_FORCEUCASE = false,
@@ -95,18 +264,23 @@ struct Checker : public Aff_Data {
 	}
 	auto spell_priv(std::string& s) const -> bool;
 	auto spell_break(std::string& s, size_t depth = 0) const -> bool;
-	auto spell_casing(std::string& s) const -> const Flag_Set*;
-	auto spell_casing_upper(std::string& s) const -> const Flag_Set*;
-	auto spell_casing_title(std::string& s) const -> const Flag_Set*;
+	auto spell_casing(std::string& s) const
+	    -> const Flag_Set_With_Roles*;
+	auto spell_casing_upper(std::string& s) const
+	    -> const Flag_Set_With_Roles*;
+	auto spell_casing_title(std::string& s) const
+	    -> const Flag_Set_With_Roles*;
 	auto spell_sharps(std::string& base, size_t n_pos = 0, size_t n = 0,
-	                  size_t rep = 0) const -> const Flag_Set*;
+	                  size_t rep = 0) const -> const Flag_Set_With_Roles*;
 
 	auto check_word(std::string& s, Forceucase allow_bad_forceucase = {},
 	                Hidden_Homonym skip_hidden_homonym = {}) const
-	    -> const Flag_Set*;
+	    -> const Flag_Set_With_Roles*;
+	NUSPELL_EXPORT auto find_word(std::string_view word) const
+	    -> std::pair<Word_List::const_pointer, Word_List::const_pointer>;
 	auto check_simple_word(std::string& word,
 	                       Hidden_Homonym skip_hidden_homonym = {}) const
-	    -> const Flag_Set*;
+	    -> const Flag_Set_With_Roles*;
 
 	template <Affixing_Mode m>
 	auto affix_NOT_valid(const Prefix& a) const;
@@ -117,7 +291,7 @@ struct Checker : public Aff_Data {
 	template <class AffixT>
 	auto is_circumfix(const AffixT& a) const;
 	template <Affixing_Mode m>
-	auto is_valid_inside_compound(const Flag_Set& flags) const;
+	auto is_valid_inside_compound(const Flag_Set_With_Roles& flags) const;
 
 	template <Affixing_Mode m = FULL_WORD>
 	auto strip_prefix_only(std::string& s,
@@ -287,9 +461,9 @@ struct Checker : public Aff_Data {
 
 	auto count_syllables(std::string_view word) const -> size_t;
 
-	auto check_compound_with_rules(std::string& word,
+	auto check_compound_with_rules(std::string_view word,
 	                               std::vector<const Flag_Set*>& words_data,
-	                               size_t start_pos, std::string& part,
+	                               size_t start_pos,
 	                               Forceucase allow_bad_forceucase) const
 
 	    -> Compounding_Result;
@@ -299,24 +473,24 @@ struct Checker : public Aff_Data {
 template <Affixing_Mode m>
 auto Checker::affix_NOT_valid(const Prefix& e) const
 {
-	if (m == FULL_WORD && e.cont_flags.contains(compound_onlyin_flag))
+	if (m == FULL_WORD && (e.cont_flags.roles & ROLE_ONLYINCOMPOUND))
 		return true;
 	if (m == AT_COMPOUND_END &&
-	    !e.cont_flags.contains(compound_permit_flag))
+	    !(e.cont_flags.roles & ROLE_COMPOUNDPERMITFLAG))
 		return true;
-	if (m != FULL_WORD && e.cont_flags.contains(compound_forbid_flag))
+	if (m != FULL_WORD && (e.cont_flags.roles & ROLE_COMPOUNDFORBIDFLAG))
 		return true;
 	return false;
 }
 template <Affixing_Mode m>
 auto Checker::affix_NOT_valid(const Suffix& e) const
 {
-	if (m == FULL_WORD && e.cont_flags.contains(compound_onlyin_flag))
+	if (m == FULL_WORD && (e.cont_flags.roles & ROLE_ONLYINCOMPOUND))
 		return true;
 	if (m == AT_COMPOUND_BEGIN &&
-	    !e.cont_flags.contains(compound_permit_flag))
+	    !(e.cont_flags.roles & ROLE_COMPOUNDPERMITFLAG))
 		return true;
-	if (m != FULL_WORD && e.cont_flags.contains(compound_forbid_flag))
+	if (m != FULL_WORD && (e.cont_flags.roles & ROLE_COMPOUNDFORBIDFLAG))
 		return true;
 	return false;
 }
@@ -325,14 +499,14 @@ auto Checker::outer_affix_NOT_valid(const AffixT& e) const
 {
 	if (affix_NOT_valid<m>(e))
 		return true;
-	if (e.cont_flags.contains(need_affix_flag))
+	if (e.cont_flags.roles & ROLE_NEEDAFFIX)
 		return true;
 	return false;
 }
 template <class AffixT>
 auto Checker::is_circumfix(const AffixT& a) const
 {
-	return a.cont_flags.contains(circumfix_flag);
+	return bool(a.cont_flags.roles & ROLE_CIRCUMFIX);
 }
 
 template <class AffixInner, class AffixOuter>
@@ -342,11 +516,12 @@ auto cross_valid_inner_outer(const AffixInner& inner, const AffixOuter& outer)
 }
 
 template <class Affix>
-auto cross_valid_inner_outer(const Flag_Set& word_flags, const Affix& afx)
+auto cross_valid_inner_outer(const Flag_Set_With_Roles& word_flags,
+                             const Affix& afx)
 {
 	return word_flags.contains(afx.flag);
 }
 
-} // namespace v5
+} // namespace v6
 } // namespace nuspell
 #endif // NUSPELL_CHECKER_HXX
@@ -21,12 +21,43 @@
 
 #include <fstream>
 #include <iostream>
+#include <optional>
 #include <stdexcept>
+#include <thread>
 
 using namespace std;
 
 namespace nuspell {
-inline namespace v5 {
+inline namespace v6 {
+
+Spell_Context::Spell_Context() : pools(make_unique<Scratch_Pools>()) {}
+Spell_Context::Spell_Context(Spell_Context&& other) noexcept = default;
+auto Spell_Context::operator=(Spell_Context&& other) noexcept
+    -> Spell_Context& = default;
+Spell_Context::~Spell_Context() = default;
+
+auto Spell_Context::get_pools() -> Scratch_Pools&
+{
+	// A moved-from context gets new buffers.
+	if (!pools)
+		pools = make_unique<Scratch_Pools>();
+	return *pools;
+}
+
+namespace {
+/**
+ * @brief Replaces a shared suggestion cache with an empty one of its capacity
+ *
+ * Used when a setting that changes the suggestions changes. Other copies of
+ * the dictionary keep the old cache.
+ */
+auto detach_suggest_cache(shared_ptr<Clock_Cache<List_Strings>>& cache) -> void
+{
+	if (cache)
+		cache = make_shared<Clock_Cache<List_Strings>>(
+		    cache->statistics().capacity);
+}
+} // namespace
 
 Dictionary::Dictionary(std::istream& aff, std::istream& dic)
 {
@@ -79,6 +110,234 @@ auto Dictionary::load_from_path(const std::string& file_path_without_extension)
 	return load_from_aff_dic(aff_file, dic_file);
 }
 
+/**
+ * @brief Create a dictionary from a compiled file
+ *
+ * The file must have been written with save_compiled() by the same version of
+ * the library. Loading it skips parsing the .aff and .dic files, decoding the
+ * flags and converting the encoding. The file is mapped into memory and the
+ * words, their perfect hash table and their Bloom filter are used in place,
+ * so the word list is frozen after loading, see freeze(). The dictionary and
+ * its copies keep the file mapped. Only the affixes, the other small tables
+ * and the distinct flag sets are decoded, plus one array with an entry per
+ * word that points to the mapped word.
+ *
+ * The tables are rebuilt instead on big endian machines and when the file was
+ * written by a build of the library with a different std::hash.
+ *
+ * @param file_path path to the compiled dictionary
+ * @return Dictionary object
+ * @throws Dictionary_Loading_Error on error
+ */
+auto Dictionary::load_compiled(const std::string& file_path) -> Dictionary
+{
+	auto file = make_shared<Mapped_File>(file_path);
+	if (!file->is_open()) {
+		auto err = "Compiled dictionary " + file_path + " not found";
+		throw Dictionary_Loading_Error(err);
+	}
+	auto d = Dictionary();
+	if (!d.Aff_Data::load_compiled(file->view(), file)) {
+		auto err = "Invalid or incompatible compiled dictionary " +
+		           file_path;
+		throw Dictionary_Loading_Error(err);
+	}
+	return d;
+}
+
+/**
+ * @brief Writes the dictionary in compiled format to a file
+ *
+ * The written file can be loaded later with load_compiled().
+ *
+ * @param file_path path of the file to be written
+ * @throws std::runtime_error if the file can not be written
+ */
+auto Dictionary::save_compiled(const std::string& file_path) const -> void
+{
+	std::ofstream file(file_path, ios_base::binary);
+	auto ok = file.is_open() && Aff_Data::save_compiled(file);
+	file.close();
+	if (!ok || file.fail())
+		throw std::runtime_error("Can not write compiled dictionary " +
+		                         file_path);
+}
+
+/**
+ * @brief Prepares the dictionary for faster lookups
+ *
+ * Builds a perfect hash index of the words. This takes some time and is
+ * worthwhile when the dictionary is used for checking many words, e.g. in a
+ * long-running process. The results of spell() and suggest() do not change.
+ *
+ * Building the index can fail, which is very unlikely. It needs a search for
+ * a hash function without collisions, and that search is bounded. Then the
+ * dictionary keeps using the ordinary hash table, which gives the same results
+ * only a bit slower.
+ *
+ * @return true if the index was built, false otherwise
+ */
+auto Dictionary::freeze() -> bool
+{
+	auto ok = words.freeze();
+	ngram_image.reset();
+	return ok;
+}
+
+/**
+ * @brief Enables the cache of spell() results
+ *
+ * Words that are checked often are answered from the cache. The cache is
+ * bounded and evicts the least recently used words (approximately). It is
+ * safe to call spell() concurrently from multiple threads with the cache
+ * enabled. Copies of the Dictionary share the cache.
+ *
+ * This function itself must not be called concurrently with spell().
+ *
+ * @param capacity maximal number of cached words, 0 disables the cache
+ */
+auto Dictionary::set_spell_cache_capacity(size_t capacity) -> void
+{
+	if (capacity == 0)
+		spell_cache.reset();
+	else
+		spell_cache = make_shared<Clock_Cache<bool>>(capacity);
+}
+
+/**
+ * @brief Gets the statistics of the cache of spell() results
+ * @return statistics, all zero if the cache is not enabled
+ */
+auto Dictionary::spell_cache_statistics() const -> Cache_Statistics
+{
+	if (!spell_cache)
+		return {};
+	return spell_cache->statistics();
+}
+
+/**
+ * @brief Enables the cache of suggest() results
+ *
+ * The same misspellings tend to recur, and suggest() is slow, mostly when it
+ * has to scan the whole dictionary for ngram suggestions. The cache is bounded
+ * by the approximate memory used by the cached suggestion lists. Lists for
+ * which more candidates had to be tried are kept longer, see Suggest_Budget
+ * for how the candidates are counted. Like the spell cache, it is safe to
+ * call suggest() concurrently and copies of the Dictionary share the cache.
+ * The cache is emptied, and no longer shared, when the trigram index is
+ * enabled or disabled, see set_ngram_index_enabled().
+ *
+ * This function itself must not be called concurrently with suggest().
+ *
+ * @param bytes maximal memory used by the cache, 0 disables the cache
+ */
+auto Dictionary::set_suggest_cache_capacity(size_t bytes) -> void
+{
+	if (bytes == 0)
+		suggest_cache.reset();
+	else
+		suggest_cache = make_shared<Clock_Cache<List_Strings>>(bytes);
+}
+
+/**
+ * @brief Gets the statistics of the cache of suggest() results
+ *
+ * The capacity and charge are in bytes.
+ *
+ * @return statistics, all zero if the cache is not enabled
+ */
+auto Dictionary::suggest_cache_statistics() const -> Cache_Statistics
+{
+	if (!suggest_cache)
+		return {};
+	return suggest_cache->statistics();
+}
+
+/**
+ * @brief Enables the precomputed lowercase image of the word list
+ *
+ * For the ngram suggestions, each call of suggest() may scan the whole word
+ * list, converting every word to UTF-32 and lowercasing it. With the image
+ * enabled that is done once, on the first such call, and later calls scan the
+ * precomputed words. It costs about 4 to 8 bytes per character of the words.
+ * The suggestions are the same with or without it.
+ *
+ * Disabling the image disables the trigram index too, see
+ * set_ngram_index_enabled(). This function must not be called concurrently
+ * with suggest().
+ *
+ * @param enable true to enable, false to disable and free the image
+ */
+auto Dictionary::set_ngram_image_enabled(bool enable) -> void
+{
+	auto was_indexed = ngram_image.is_indexed();
+	ngram_image.set_enabled(enable);
+	if (ngram_image.is_indexed() != was_indexed)
+		detach_suggest_cache(suggest_cache);
+}
+
+/**
+ * @brief Enables the trigram index for the ngram suggestions
+ *
+ * The index maps the trigrams of the lowercase words to the words that contain
+ * them. With it, suggest() scores only the words that share a trigram with
+ * the misspelled word instead of the whole word list. If fewer than 100 words
+ * share a trigram, or more than a quarter of the words, the whole list is
+ * scanned as without the index.
+ *
+ * It is an approximation. Of the words that would be chosen as the 100 best
+ * roots for the ngram suggestions, those that share no trigram with the
+ * misspelled word are missed, and then other roots take their place. For a
+ * lowercase misspelled word of n characters, such roots score at most 2n + 1
+ * (its letters, its bigrams and a common prefix of at most two characters),
+ * while a root that differs by one letter usually scores about 3n. Measured on
+ * a list of 38,000 English words with misspellings made by one or two random
+ * edits, 92% of the 100 best roots are found on average, but for some words
+ * as few as 20%. The index costs about 4 bytes per character of the words, on
+ * top of the image.
+ *
+ * Because the suggestions change, enabling or disabling the index empties the
+ * cache of suggest() results, and copies of this dictionary no longer share
+ * it. Enabling the index enables the image too, see set_ngram_image_enabled().
+ * This function must not be called concurrently with suggest().
+ *
+ * @param enable true to enable, false to disable and free the index
+ */
+auto Dictionary::set_ngram_index_enabled(bool enable) -> void
+{
+	auto was_indexed = ngram_image.is_indexed();
+	if (enable)
+		ngram_image.set_enabled(true);
+	ngram_image.set_indexed(enable);
+	if (ngram_image.is_indexed() != was_indexed)
+		detach_suggest_cache(suggest_cache);
+}
+
+/**
+ * @brief Sets the number of threads for scoring the ngram suggestion roots
+ *
+ * The slowest part of suggest() for misspelled words that are far from any
+ * correct word is scoring every word of the dictionary as a candidate root
+ * for the ngram suggestions. With more than one thread, that scan is split
+ * among the calling thread and n - 1 helper threads. It is done only for
+ * large dictionaries, where the work outweighs handing it over. The helper
+ * threads are owned by the dictionary. They are started by the first such
+ * scan and reused by the next ones, and only one suggest() at a time uses
+ * them, the others scan alone. The suggestions are the same as with one
+ * thread.
+ *
+ * The default is 1. This function must not be called concurrently with
+ * suggest().
+ *
+ * @param n number of threads, 0 for std::thread::hardware_concurrency()
+ */
+auto Dictionary::set_ngram_threads(size_t n) -> void
+{
+	if (n == 0)
+		n = max(thread::hardware_concurrency(), 1u);
+	ngram_threads.set_num_threads(n);
+}
+
 /**
  * @brief Checks if a given word is correct
  * @param word any word
@@ -91,8 +350,32 @@ auto Dictionary::spell(std::string_view word) const -> bool
 		return false;
 	if (unlikely(!ok_enc))
 		return false;
-	auto word_buf = string(word);
-	return spell_priv(word_buf);
+	auto ret = false;
+	if (spell_cache && spell_cache->get(word, ret))
+		return ret;
+	auto word_buf_buf = Scratch<string>();
+	auto& word_buf = *word_buf_buf;
+	word_buf = word;
+	ret = spell_priv(word_buf);
+	if (spell_cache)
+		spell_cache->put(word, ret);
+	return ret;
+}
+
+/**
+ * @brief Checks if a given word is correct, using the given buffers
+ *
+ * Same as spell(std::string_view) but the temporary buffers are taken from
+ * @p ctx instead of the ones kept per thread by the library.
+ *
+ * @param word any word
+ * @param ctx temporary buffers, not used by other threads during the call
+ * @return true if correct, false otherwise
+ */
+auto Dictionary::spell(std::string_view word, Spell_Context& ctx) const -> bool
+{
+	auto scope = Scratch_Pools_Scope(ctx.get_pools());
+	return spell(word);
 }
 
 /**
@@ -109,7 +392,80 @@ auto Dictionary::suggest(std::string_view word,
 		return;
 	if (unlikely(!ok_enc))
 		return;
+	if (!suggest_cache) {
+		suggest_priv(word, out);
+		return;
+	}
+	if (suggest_cache->get(word, out))
+		return;
+	// The work counter of a budget measures the cost of the list. If the
+	// caller gave no budget, one without limits is used for counting.
+	auto budget = current_suggest_budget();
+	auto counting_budget = Suggest_Budget();
+	auto counting_scope = optional<Suggest_Budget_Scope>();
+	if (!budget) {
+		budget = &counting_budget;
+		counting_scope.emplace(counting_budget);
+	}
+	auto work_before = budget->work;
 	suggest_priv(word, out);
+	if (budget->truncated)
+		return;
+
+	// Memory of the key, the list and the bookkeeping of the cache.
+	auto bytes = 128 + size(word) + sizeof(string) * size(out);
+	for (auto& sug : out)
+		bytes += size(sug);
+	// The weight grows with the logarithm of the number of candidates that
+	// were tried. It is 1 below 1024, the usual count when only the edits
+	// of the word are tried, and goes up to 8 for 131072 or more, reached
+	// by the ngram scans of large dictionaries.
+	auto work = budget->work - work_before;
+	auto weight = 1u;
+	for (work /= 1024; work != 0 && weight != 8; work /= 2)
+		++weight;
+	suggest_cache->put(word, out, bytes, weight);
+}
+
+/**
+ * @brief Suggests correct words for a given incorrect word, using the given
+ * buffers
+ *
+ * Same as suggest(std::string_view, std::vector<std::string>&) but the
+ * temporary buffers are taken from @p ctx instead of the ones kept per thread
+ * by the library.
+ *
+ * @param[in] word incorrect word
+ * @param[out] out this object will be populated with the suggestions
+ * @param ctx temporary buffers, not used by other threads during the call
+ */
+auto Dictionary::suggest(std::string_view word, std::vector<std::string>& out,
+                         Spell_Context& ctx) const -> void
+{
+	auto scope = Scratch_Pools_Scope(ctx.get_pools());
+	suggest(word, out);
+}
+
+/**
+ * @brief Suggests correct words for a given incorrect word, within limits
+ *
+ * Same as suggest(std::string_view, std::vector<std::string>&) but stops
+ * trying candidates when the deadline or the work limit of @p budget is
+ * reached. Then @p out has the suggestions found so far, which may be fewer
+ * or worse than the complete ones, and budget.truncated is set. A single
+ * candidate is not interrupted, so the deadline can be overrun by the time it
+ * takes to check one word. Truncated results are not stored in the suggestion
+ * cache, but complete results from the cache are returned as usual.
+ *
+ * @param[in] word incorrect word
+ * @param[out] out this object will be populated with the suggestions
+ * @param budget the limits, updated with the work done
+ */
+auto Dictionary::suggest(std::string_view word, std::vector<std::string>& out,
+                         Suggest_Budget& budget) const -> void
+{
+	auto scope = Suggest_Budget_Scope(budget);
+	suggest(word, out);
 }
-} // namespace v5
+} // namespace v6
 } // namespace nuspell
@@ -26,8 +26,11 @@
 
 #include "suggester.hxx"
 
+#include <chrono>
+#include <limits>
+
 namespace nuspell {
-inline namespace v5 {
+inline namespace v6 {
 
 /**
  * @brief The only important public exception
@@ -37,10 +40,71 @@ class Dictionary_Loading_Error : public std::runtime_error {
 	using std::runtime_error::runtime_error;
 };
 
+/**
+ * @brief Statistics of a result cache of Dictionary.
+ */
+struct Cache_Statistics {
+	size_t capacity = 0;  /**< maximal total charge of the entries */
+	size_t charge = 0;    /**< current total charge of the entries */
+	size_t size = 0;      /**< current number of entries */
+	size_t hits = 0;      /**< number of lookups that found an entry */
+	size_t misses = 0;    /**< number of lookups that found nothing */
+	size_t evictions = 0; /**< number of entries evicted to make room */
+};
+
+/**
+ * @brief Limits on the time and the work spent by Dictionary::suggest()
+ *
+ * The unit of work is one candidate word, either checked for correctness or
+ * scored as a root or a guess for the ngram suggestions. When the deadline is
+ * reached or the next step would exceed the work limit, the search stops and
+ * the suggestions found so far are returned. The counters are not reset by
+ * suggest(), so one budget can be shared by several calls.
+ */
+struct Suggest_Budget {
+	/** Time after which no more candidates are tried. */
+	std::chrono::steady_clock::time_point deadline =
+	    std::chrono::steady_clock::time_point::max();
+	/** Maximal number of candidates. */
+	size_t max_work = std::numeric_limits<size_t>::max();
+	/** Number of candidates tried so far. */
+	size_t work = 0;
+	/** Set when the search was stopped because of the limits. */
+	bool truncated = false;
+};
+
+/**
+ * @brief Reusable temporary buffers for spelling and suggesting.
+ *
+ * Dictionary::spell() and Dictionary::suggest() need temporary strings and
+ * vectors. By default they are kept per thread by the library. A server can
+ * instead keep one Spell_Context per worker and pass it to each call. The
+ * buffers keep their capacity between calls, so after the first few calls
+ * they are not allocated again.
+ *
+ * A Spell_Context must not be used by two threads at the same time. It can be
+ * used with any Dictionary.
+ */
+class NUSPELL_EXPORT Spell_Context {
+	std::unique_ptr<Scratch_Pools> pools;
+
+	auto get_pools() -> Scratch_Pools&;
+	friend class Dictionary;
+
+      public:
+	Spell_Context();
+	Spell_Context(Spell_Context&& other) noexcept;
+	auto operator=(Spell_Context&& other) noexcept -> Spell_Context&;
+	~Spell_Context();
+};
+
 /**
  * @brief The only important public class
  */
 class NUSPELL_EXPORT Dictionary : private Suggester {
+	std::shared_ptr<Clock_Cache<bool>> spell_cache;
+	std::shared_ptr<Clock_Cache<List_Strings>> suggest_cache;
+
 	Dictionary(std::istream& aff, std::istream& dic);
 
       public:
@@ -49,11 +113,26 @@ class NUSPELL_EXPORT Dictionary : private Suggester {
 	    -> Dictionary;
 	auto static load_from_path(
 	    const std::string& file_path_without_extension) -> Dictionary;
+	auto static load_compiled(const std::string& file_path) -> Dictionary;
+	auto save_compiled(const std::string& file_path) const -> void;
+	auto freeze() -> bool;
+	auto set_spell_cache_capacity(size_t capacity) -> void;
+	auto spell_cache_statistics() const -> Cache_Statistics;
+	auto set_suggest_cache_capacity(size_t bytes) -> void;
+	auto suggest_cache_statistics() const -> Cache_Statistics;
+	auto set_ngram_image_enabled(bool enable) -> void;
+	auto set_ngram_index_enabled(bool enable) -> void;
+	auto set_ngram_threads(size_t n) -> void;
 	auto spell(std::string_view word) const -> bool;
+	auto spell(std::string_view word, Spell_Context& ctx) const -> bool;
 	auto suggest(std::string_view word, std::vector<std::string>& out) const
 	    -> void;
+	auto suggest(std::string_view word, std::vector<std::string>& out,
+	             Spell_Context& ctx) const -> void;
+	auto suggest(std::string_view word, std::vector<std::string>& out,
+	             Suggest_Budget& budget) const -> void;
 };
 
-} // namespace v5
+} // namespace v6
 } // namespace nuspell
 #endif // NUSPELL_DICTIONARY_HXX
@@ -55,7 +55,7 @@
 using namespace std;
 
 namespace nuspell {
-inline namespace v5 {
+inline namespace v6 {
 #ifdef _WIN32
 const auto PATHSEP = ';';
 const auto DIRSEP = '\\';
@@ -570,5 +570,5 @@ auto Dict_Finder_For_CLI_Tool::get_dictionary_path(
 	}
 	return {};
 }
-} // namespace v5
+} // namespace v6
 } // namespace nuspell
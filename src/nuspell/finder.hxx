@@ -39,7 +39,7 @@ NUSPELL_MSVC_PRAGMA_WARNING(push)
 NUSPELL_MSVC_PRAGMA_WARNING(disable : 4251)
 
 namespace nuspell {
-inline namespace v5 {
+inline namespace v6 {
 
 NUSPELL_EXPORT auto append_default_dir_paths(std::vector<std::string>& paths)
     -> void;
@@ -78,7 +78,7 @@ class NUSPELL_EXPORT Dict_Finder_For_CLI_Tool {
 	auto& get_dictionaries() const { return dict_multimap; }
 	auto get_dictionary_path(const std::string& dict) const -> std::string;
 };
-} // namespace v5
+} // namespace v6
 } // namespace nuspell
 NUSPELL_MSVC_PRAGMA_WARNING(pop)
 #endif // NUSPELL_FINDER_HXX
@@ -23,18 +23,22 @@
 
 #include <algorithm>
 #include <cmath>
-#include <forward_list>
+#include <cstdint>
 #include <functional>
 #include <iterator>
+#include <limits>
+#include <memory>
+#include <mutex>
 #include <stack>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
 namespace nuspell {
-inline namespace v5 {
+inline namespace v6 {
 
 template <class It>
 class Subrange {
@@ -312,6 +316,75 @@ auto swap(String_Set<CharT>& a, String_Set<CharT>& b)
 
 using Flag_Set = String_Set<char16_t>;
 
+/**
+ * @internal
+ * @brief Options in the aff file that give a special meaning to a flag.
+ *
+ * The values are bits of the mask in Flag_Set_With_Roles.
+ */
+enum Flag_Role : uint32_t {
+	ROLE_FORBIDDENWORD = 1 << 0,
+	ROLE_NEEDAFFIX = 1 << 1,
+	ROLE_ONLYINCOMPOUND = 1 << 2,
+	ROLE_HIDDEN_HOMONYM = 1 << 3,
+	ROLE_NOSUGGEST = 1 << 4,
+	ROLE_KEEPCASE = 1 << 5,
+	ROLE_CIRCUMFIX = 1 << 6,
+	ROLE_WARN = 1 << 7,
+	ROLE_SUBSTANDARD = 1 << 8,
+	ROLE_COMPOUNDFLAG = 1 << 9,
+	ROLE_COMPOUNDBEGIN = 1 << 10,
+	ROLE_COMPOUNDMIDDLE = 1 << 11,
+	ROLE_COMPOUNDEND = 1 << 12,
+	ROLE_COMPOUNDPERMITFLAG = 1 << 13,
+	ROLE_COMPOUNDFORBIDFLAG = 1 << 14,
+	ROLE_COMPOUNDROOT = 1 << 15,
+	ROLE_FORCEUCASE = 1 << 16
+};
+
+/**
+ * @internal
+ * @brief Mapping from roles to the flags that have them.
+ */
+class Role_Flags {
+	static constexpr size_t num_roles = 17;
+	char16_t flags[num_roles] = {};
+
+      public:
+	auto set(Flag_Role role, char16_t flag) -> void
+	{
+		for (size_t i = 0; i != num_roles; ++i)
+			if (role == uint32_t(1) << i)
+				flags[i] = flag;
+	}
+	auto roles_of(const Flag_Set& s) const -> uint32_t
+	{
+		auto ret = uint32_t(0);
+		for (size_t i = 0; i != num_roles; ++i)
+			if (s.contains(flags[i]))
+				ret |= uint32_t(1) << i;
+		return ret;
+	}
+};
+
+/**
+ * @internal
+ * @brief Flag set with a precomputed mask of the roles of its flags.
+ *
+ * The mask is filled at load time from Role_Flags. Testing for a flag with
+ * special meaning like FORBIDDENWORD is then a single AND instead of a search
+ * in the set. The mask is not updated when the set is modified.
+ */
+struct Flag_Set_With_Roles : public Flag_Set {
+	uint32_t roles = 0;
+
+	using Flag_Set::Flag_Set;
+	using Flag_Set::operator=;
+	Flag_Set_With_Roles() = default;
+	explicit Flag_Set_With_Roles(const Flag_Set& s) : Flag_Set(s) {}
+	auto assign_roles(const Role_Flags& r) { roles = r.roles_of(*this); }
+};
+
 class Substr_Replacer {
       public:
 	using Str = std::string;
@@ -348,6 +421,7 @@ class Substr_Replacer {
 		return *this;
 	}
 
+	auto& data() const { return table; }
 	auto replace(Str& s) const -> Str&;
 	auto replace_copy(Str s) const -> Str
 	{
@@ -521,14 +595,97 @@ struct identity {
 	}
 };
 
+/**
+ * @internal
+ * @brief Mixes the bits of a hash value.
+ *
+ * Hash values from std::hash can have weak bits or be only 32 bit wide. After
+ * mixing every bit of the result depends on every bit of the input (the
+ * finalizer of SplitMix64).
+ */
+inline auto mix_hash(uint64_t x) -> uint64_t
+{
+	x ^= x >> 30;
+	x *= 0xbf58476d1ce4e5b9;
+	x ^= x >> 27;
+	x *= 0x94d049bb133111eb;
+	x ^= x >> 31;
+	return x;
+}
+
+/**
+ * @internal
+ * @brief Read-only array that owns its elements or views external ones.
+ *
+ * The external elements are usually in a mapped file. They are not copied,
+ * so they must outlive the array and all its copies. Modifying the array
+ * through make_owned() copies them first.
+ */
+template <class T>
+class Mappable_Array {
+	std::vector<T> owned;
+	const T* external = nullptr;
+	size_t external_size = 0;
+
+      public:
+	Mappable_Array() = default;
+	Mappable_Array(std::vector<T>&& v) : owned(std::move(v)) {}
+
+	/**
+	 * @brief Views external elements, dropping the owned ones.
+	 * @param p pointer to the first element, suitably aligned for T
+	 * @param n number of elements
+	 */
+	auto view(const T* p, size_t n) -> void
+	{
+		owned = std::vector<T>();
+		external = p;
+		external_size = n;
+	}
+	auto make_owned() -> std::vector<T>&
+	{
+		if (external) {
+			owned.assign(external, external + external_size);
+			external = nullptr;
+			external_size = 0;
+		}
+		return owned;
+	}
+	auto is_view() const noexcept { return external != nullptr; }
+	auto data() const noexcept
+	{
+		return external ? external : owned.data();
+	}
+	auto size() const noexcept
+	{
+		return external ? external_size : owned.size();
+	}
+	auto empty() const noexcept { return size() == 0; }
+	auto begin() const noexcept { return data(); }
+	auto end() const noexcept { return data() + size(); }
+	auto& operator[](size_t i) const { return data()[i]; }
+};
+
+/**
+ * @internal
+ * @brief Hash multimap with open addressing.
+ *
+ * All elements are stored in one contiguous array. Collisions are resolved
+ * with linear probing using the Robin Hood strategy, so the elements in a
+ * cluster are ordered by their home slot. Elements with equal keys are kept
+ * adjacent, in order of insertion, and equal_range() returns a contiguous
+ * range of them.
+ *
+ * Along the array of elements there is an array of small records with the
+ * distance of the element from its home slot and few bits of the hash (tag).
+ * Lookups scan only these records and compare keys only on tag match.
+ *
+ * There is no wrap-around at the end of the array. When needed, the array
+ * grows past the capacity instead. Key and T must be default constructible,
+ * empty slots hold default constructed values.
+ */
 template <class Key, class T>
 class Hash_Multimap {
-	using bucket_type = std::forward_list<std::pair<Key, T>>;
-	static constexpr float max_load_fact = 7.0 / 8.0;
-	std::vector<bucket_type> data;
-	size_t sz = 0;
-	size_t max_load_factor_capacity = 0;
-
       public:
 	using key_type = Key;
 	using mapped_type = T;
@@ -538,39 +695,54 @@ class Hash_Multimap {
 	using hasher = std::hash<Key>;
 	using reference = value_type&;
 	using const_reference = const value_type&;
-	using pointer = typename bucket_type::pointer;
-	using const_pointer = typename bucket_type::const_pointer;
-	using local_iterator = typename bucket_type::iterator;
-	using local_const_iterator = typename bucket_type::const_iterator;
+	using pointer = value_type*;
+	using const_pointer = const value_type*;
+
+      private:
+	struct Slot_Info {
+		uint16_t dist = 0; // distance from home slot + 1, 0 if empty
+		uint16_t tag = 0;
+	};
+	static constexpr float max_load_fact = 7.0 / 8.0;
+	static constexpr size_t max_dist = UINT16_MAX;
+	std::vector<value_type> slots;
+	std::vector<Slot_Info> infos;
+	size_t sz = 0;
+	size_t max_load_factor_capacity = 0;
+	size_t capacity_mask = 0;
 
+	static auto get_tag(size_t hash) -> uint16_t
+	{
+		return hash >> (std::numeric_limits<size_t>::digits - 16);
+	}
+
+      public:
 	Hash_Multimap() = default;
 
 	auto size() const noexcept { return sz; }
 	auto empty() const noexcept { return size() == 0; }
+	auto capacity() const noexcept
+	{
+		return slots.empty() ? size_t(0) : capacity_mask + 1;
+	}
 
 	auto rehash(size_t count)
 	{
-		if (empty()) {
-			size_t capacity = 16;
-			while (capacity <= count)
-				capacity <<= 1;
-			data.resize(capacity);
-			max_load_factor_capacity =
-			    std::ceil(capacity * max_load_fact);
-			return;
-		}
-		if (count < size() / max_load_fact)
+		if (!empty() && count < size() / max_load_fact)
 			count = size() / max_load_fact;
+		size_t capacity = 16;
+		while (capacity <= count)
+			capacity <<= 1;
 		auto n = Hash_Multimap();
-		n.rehash(count);
-		for (auto& b : data) {
-			for (auto& x : b) {
-				n.insert(std::move(x));
-			}
+		n.slots.resize(capacity);
+		n.infos.resize(capacity);
+		n.capacity_mask = capacity - 1;
+		n.max_load_factor_capacity = std::ceil(capacity * max_load_fact);
+		for (size_t i = 0; i != slots.size(); ++i) {
+			if (infos[i].dist != 0)
+				n.insert(std::move(slots[i]));
 		}
-		data.swap(n.data);
-		sz = n.sz;
-		max_load_factor_capacity = n.max_load_factor_capacity;
+		*this = std::move(n);
 	}
 
 	auto reserve(size_t count) -> void
@@ -578,70 +750,671 @@ class Hash_Multimap {
 		rehash(std::ceil(count / max_load_fact));
 	}
 
-      private:
-	auto prepare_for_insert(const key_type& key)
-	    -> std::pair<bucket_type&, local_iterator>
+	auto insert(value_type&& value) -> pointer
 	{
-		auto hash = hasher();
-		if (sz == max_load_factor_capacity) {
+		if (sz == max_load_factor_capacity)
 			reserve(sz + 1);
-		}
-		auto h = hash(key);
-		auto h_mod = h & (data.size() - 1);
-		auto& bucket = data[h_mod];
-		auto prev = bucket.before_begin();
-		auto curr = begin(bucket);
-		// find first entry with same key
-		for (; curr != end(bucket); prev = curr++) {
-			if (curr->first == key)
+		auto& key = value.first;
+		auto hash = hasher()(key);
+		auto tag = get_tag(hash);
+		// Find the slot after the last entry with the same key, or if
+		// there is no such key, after the last entry with the same home
+		// slot.
+		auto i = hash & capacity_mask;
+		auto dist = size_t(1);
+		auto found_key = false;
+		for (; i != slots.size(); ++i, ++dist) {
+			auto& info = infos[i];
+			if (info.dist < dist)
 				break;
-		}
-		// find last entry with same key
-		for (; curr != end(bucket); prev = curr++) {
-			if (curr->first != key)
+			auto same_key = info.dist == dist && info.tag == tag &&
+			                slots[i].first == key;
+			if (same_key)
+				found_key = true;
+			else if (found_key)
 				break;
 		}
+		// Find the first empty slot, elements from i up to it will be
+		// shifted by one.
+		auto empty_i = i;
+		auto too_far = dist > max_dist;
+		for (; empty_i != slots.size() && infos[empty_i].dist != 0;
+		     ++empty_i)
+			too_far |= infos[empty_i].dist == max_dist;
+		if (too_far) {
+			rehash(2 * capacity());
+			return insert(std::move(value));
+		}
+		if (empty_i == slots.size()) {
+			slots.emplace_back();
+			infos.emplace_back();
+		}
+		auto slots_it = begin(slots);
+		std::move_backward(slots_it + i, slots_it + empty_i,
+		                   slots_it + empty_i + 1);
+		for (auto j = empty_i; j != i; --j) {
+			infos[j] = infos[j - 1];
+			++infos[j].dist;
+		}
+		slots[i] = std::move(value);
+		infos[i] = {uint16_t(dist), tag};
 		++sz;
-		return {bucket, prev};
+		return &slots[i];
+	}
+	template <class... Args>
+	auto emplace(Args&&... a)
+	{
+		return insert(value_type(std::forward<Args>(a)...));
 	}
 
+	/**
+	 * @brief Replaces each element x with f(x).
+	 *
+	 * The key of f(x) must be equal to the key of x, so that the element
+	 * can stay where it is.
+	 */
+	template <class F>
+	auto transform_elements(F f) -> void
+	{
+		for (size_t i = 0; i != slots.size(); ++i) {
+			if (infos[i].dist != 0)
+				slots[i] = f(std::as_const(slots[i]));
+		}
+	}
+
+	auto equal_range(const key_type& key) const
+	    -> std::pair<const_pointer, const_pointer>
+	{
+		return equal_range(key, hasher()(key));
+	}
+	/**
+	 * @brief Finds the elements with a given key and precomputed hash.
+	 * @param key key
+	 * @param hash must be equal to hasher()(key)
+	 */
+	auto equal_range(const key_type& key, size_t hash) const
+	    -> std::pair<const_pointer, const_pointer>
+	{
+		if (empty())
+			return {};
+		auto tag = get_tag(hash);
+		auto i = hash & capacity_mask;
+		for (auto dist = size_t(1); i != slots.size(); ++i, ++dist) {
+			auto& info = infos[i];
+			if (info.dist < dist)
+				break;
+			if (info.dist != dist || info.tag != tag ||
+			    slots[i].first != key)
+				continue;
+			auto j = i + 1;
+			while (j != slots.size() && infos[j].dist == ++dist &&
+			       infos[j].tag == tag && slots[j].first == key)
+				++j;
+			return {&slots[i], slots.data() + j};
+		}
+		return {};
+	}
+
+	auto bucket_count() const -> size_type { return slots.size(); }
+	auto bucket_data(size_type i) const
+	{
+		auto p = &slots[i];
+		return Subrange(p, p + (infos[i].dist != 0));
+	}
+};
+
+/**
+ * @internal
+ * @brief Immutable hash multimap indexed with a minimal perfect hash function.
+ *
+ * It is built from a Hash_Multimap and keeps the elements in the same order.
+ * The distinct keys are split by their hash into small buckets. For each
+ * bucket, starting from the largest, a pilot value is searched for that maps
+ * its keys into free positions. There are 1% more positions than keys, which
+ * makes the search much faster. The few keys that end up in the positions past
+ * the number of keys are remapped into the free positions below it, so every
+ * key has its own slot and there are exactly as many slots as keys (hash and
+ * displace, like PTHash).
+ *
+ * A lookup computes the slot of the key directly, without probing. Keys that
+ * are not in the map are mapped to some slot too, so each slot keeps 16 bits
+ * of the hash (fingerprint) that rejects most of them before the keys are
+ * compared.
+ *
+ * The tables other than the elements have no pointers, so they can be saved
+ * and later viewed in place with assign(). They depend on std::hash.
+ */
+template <class Key, class T>
+class Perfect_Hash_Multimap {
       public:
-	auto insert(value_type&& value)
+	using key_type = Key;
+	using mapped_type = T;
+	using value_type = std::pair<Key, T>;
+	using size_type = std::size_t;
+	using difference_type = std::ptrdiff_t;
+	using hasher = std::hash<Key>;
+	using reference = value_type&;
+	using const_reference = const value_type&;
+	using pointer = value_type*;
+	using const_pointer = const value_type*;
+
+	struct Slot {
+		uint32_t first = 0; // index of the first element with the key
+		uint16_t count = 0;
+		uint16_t fingerprint = 0;
+	};
+	struct Tables {
+		Mappable_Array<Slot> slots;
+		Mappable_Array<uint32_t> pilots;
+		Mappable_Array<uint32_t> remap;
+		size_t num_positions = 0;
+	};
+
+      private:
+	static constexpr size_t avg_bucket_size = 4;
+	std::vector<value_type> elements;
+	Mappable_Array<Slot> slots;
+	Mappable_Array<uint32_t> pilots;
+	Mappable_Array<uint32_t> remap;
+	size_t num_positions = 0;
+
+	static auto get_hash(const key_type& key) -> uint64_t
 	{
-		auto& key = value.first;
-		auto [bucket, it] = prepare_for_insert(key);
-		return bucket.insert_after(it, move(value));
+		return mix_hash(hasher()(key));
 	}
-	template <class... Args>
-	auto emplace(Args&&... a)
+	static auto get_fingerprint(uint64_t hash) -> uint16_t
+	{
+		// the low 32 bits select the bucket
+		return hash >> 32;
+	}
+	auto bucket_of(uint64_t hash) const -> size_t
+	{
+		// Skewed distribution, 60% of the keys go into 30% of the
+		// buckets. Makes the search for pilots much faster.
+		constexpr auto p1 = uint64_t(0.6 * (uint64_t(1) << 32));
+		constexpr auto p2 = (uint64_t(1) << 32) - p1;
+		auto nb = uint64_t(pilots.size());
+		auto dense = nb * 3 / 10;
+		auto x = hash & UINT32_MAX;
+		if (x < p1)
+			return x * dense / p1;
+		return dense + (x - p1) * (nb - dense) / p2;
+	}
+	auto position_of(uint64_t hash, uint32_t pilot) const -> size_t
 	{
-		auto node = bucket_type();
-		auto& val = node.emplace_front(std::forward<Args>(a)...);
-		auto& key = val.first;
-		auto [bucket, it] = prepare_for_insert(key);
-		bucket.splice_after(it, node, node.before_begin());
-		return next(it);
+		auto x = mix_hash(hash ^ (pilot * 0x9e3779b97f4a7c15)) >> 32;
+		return x * uint64_t(num_positions) >> 32;
+	}
+	auto slot_of(uint64_t hash) const -> size_t
+	{
+		auto pos = position_of(hash, pilots[bucket_of(hash)]);
+		if (pos >= slots.size())
+			pos = remap[pos - slots.size()];
+		return pos;
+	}
+
+      public:
+	Perfect_Hash_Multimap() = default;
+
+	/**
+	 * @brief Builds the map from the elements of a Hash_Multimap.
+	 * @param src source map
+	 * @return true on success. On failure (too many elements, too many
+	 * elements with the same key or no pilot found) the map is unchanged.
+	 */
+	auto build(const Hash_Multimap<Key, T>& src) -> bool
+	{
+		struct Key_Info {
+			uint64_t hash;
+			uint32_t first;
+			uint32_t count;
+			size_t bucket;
+		};
+		if (src.size() > UINT32_MAX)
+			return false;
+		auto n = Perfect_Hash_Multimap();
+		n.elements.reserve(src.size());
+		for (size_t i = 0; i != src.bucket_count(); ++i)
+			for (auto& x : src.bucket_data(i))
+				n.elements.push_back(x);
+		auto keys = std::vector<Key_Info>();
+		for (size_t i = 0; i != n.elements.size(); ++i) {
+			auto& key = n.elements[i].first;
+			if (i != 0 && n.elements[i - 1].first == key) {
+				if (++keys.back().count > UINT16_MAX)
+					return false;
+				continue;
+			}
+			keys.push_back({get_hash(key), uint32_t(i), 1, 0});
+		}
+		if (keys.empty()) {
+			*this = std::move(n);
+			return true;
+		}
+		auto num_buckets = (keys.size() - 1) / avg_bucket_size + 1;
+		auto& pilots_v = n.pilots.make_owned();
+		pilots_v.resize(num_buckets);
+		n.num_positions = keys.size() + keys.size() / 100 + 1;
+
+		// Sort the keys by bucket, buckets with more keys first.
+		auto bucket_sizes = std::vector<uint32_t>(num_buckets);
+		for (auto& k : keys) {
+			k.bucket = n.bucket_of(k.hash);
+			++bucket_sizes[k.bucket];
+		}
+		auto by_bucket = [&](const Key_Info& a, const Key_Info& b) {
+			auto sa = bucket_sizes[a.bucket];
+			auto sb = bucket_sizes[b.bucket];
+			return sa != sb ? sa > sb : a.bucket < b.bucket;
+		};
+		std::sort(begin(keys), end(keys), by_bucket);
+
+		auto all_slots = std::vector<Slot>(n.num_positions);
+		auto taken = std::vector<bool>(n.num_positions);
+		auto positions = std::vector<size_t>();
+		auto max_tries = size_t(1) << 24;
+		for (auto it = begin(keys); it != end(keys);) {
+			auto b = it->bucket;
+			auto bucket_end = it + bucket_sizes[b];
+			auto pilot = size_t(0);
+			for (; pilot != max_tries; ++pilot) {
+				positions.clear();
+				auto ok = true;
+				for (auto k = it; k != bucket_end && ok; ++k) {
+					auto pos = n.position_of(k->hash, pilot);
+					ok = !taken[pos] &&
+					     std::find(begin(positions),
+					               end(positions),
+					               pos) == end(positions);
+					positions.push_back(pos);
+				}
+				if (ok)
+					break;
+			}
+			if (pilot == max_tries)
+				return false;
+			pilots_v[b] = pilot;
+			for (size_t j = 0; it != bucket_end; ++it, ++j) {
+				auto pos = positions[j];
+				taken[pos] = true;
+				all_slots[pos] = {it->first, uint16_t(it->count),
+				                  get_fingerprint(it->hash)};
+			}
+		}
+		auto& slots_v = n.slots.make_owned();
+		auto& remap_v = n.remap.make_owned();
+		slots_v.assign(begin(all_slots),
+		               begin(all_slots) + keys.size());
+		remap_v.resize(n.num_positions - keys.size());
+		auto free_pos = size_t(0);
+		for (auto pos = keys.size(); pos != n.num_positions; ++pos) {
+			if (!taken[pos])
+				continue;
+			while (taken[free_pos])
+				++free_pos;
+			taken[free_pos] = true;
+			slots_v[free_pos] = all_slots[pos];
+			remap_v[pos - keys.size()] = free_pos;
+		}
+		*this = std::move(n);
+		return true;
+	}
+
+	/**
+	 * @brief Sets the map to elements and tables saved from another map.
+	 *
+	 * The tables must have been built with the same std::hash, and the
+	 * elements must be equal to the ones of the map they were built for.
+	 * Only the consistency of the sizes and the indexes is checked, so
+	 * that lookups stay in bounds.
+	 *
+	 * @param elems elements in the order given by bucket_data()
+	 * @param t tables from tables(), possibly viewing a mapped file
+	 * @return true on success, false if the tables are inconsistent, in
+	 * which case the map is unchanged
+	 */
+	auto assign(std::vector<value_type>&& elems, Tables&& t) -> bool
+	{
+		auto num_slots = t.slots.size();
+		if (num_slots > elems.size() ||
+		    (num_slots == 0) != elems.empty() ||
+		    (num_slots != 0 && t.pilots.empty()) ||
+		    t.num_positions < num_slots ||
+		    t.remap.size() != t.num_positions - num_slots)
+			return false;
+		for (auto& x : t.slots)
+			if (x.count == 0 || x.first > elems.size() ||
+			    x.count > elems.size() - x.first)
+				return false;
+		for (auto x : t.remap)
+			if (x >= num_slots)
+				return false;
+		elements = std::move(elems);
+		slots = std::move(t.slots);
+		pilots = std::move(t.pilots);
+		remap = std::move(t.remap);
+		num_positions = t.num_positions;
+		return true;
+	}
+	/**
+	 * @brief Views the tables, for saving them.
+	 *
+	 * The returned tables are valid until the map is modified or destroyed.
+	 */
+	auto tables() const -> Tables
+	{
+		auto t = Tables();
+		t.slots.view(slots.data(), slots.size());
+		t.pilots.view(pilots.data(), pilots.size());
+		t.remap.view(remap.data(), remap.size());
+		t.num_positions = num_positions;
+		return t;
+	}
+
+	auto size() const noexcept { return elements.size(); }
+	auto empty() const noexcept { return elements.empty(); }
+	auto clear() noexcept
+	{
+		elements.clear();
+		slots = {};
+		pilots = {};
+		remap = {};
+		num_positions = 0;
+	}
+
+	/**
+	 * @brief Replaces each element x with f(x).
+	 *
+	 * The key of f(x) must be equal to the key of x, so that the element
+	 * can stay where it is.
+	 */
+	template <class F>
+	auto transform_elements(F f) -> void
+	{
+		for (auto& x : elements)
+			x = f(std::as_const(x));
 	}
 
 	auto equal_range(const key_type& key) const
-	    -> std::pair<local_const_iterator, local_const_iterator>
+	    -> std::pair<const_pointer, const_pointer>
 	{
-		auto hash = hasher();
-		if (data.empty())
+		return equal_range(key, hasher()(key));
+	}
+	/**
+	 * @brief Finds the elements with a given key and precomputed hash.
+	 * @param key key
+	 * @param key_hash must be equal to hasher()(key)
+	 */
+	auto equal_range(const key_type& key, size_t key_hash) const
+	    -> std::pair<const_pointer, const_pointer>
+	{
+		if (slots.empty())
+			return {};
+		auto hash = mix_hash(key_hash);
+		auto& s = slots[slot_of(hash)];
+		if (s.fingerprint != get_fingerprint(hash))
 			return {};
-		auto h = hash(key);
-		auto h_mod = h & (data.size() - 1);
-		auto& bucket = data[h_mod];
-		auto eq_key = [&](auto& x) { return key == x.first; };
-		auto first = std::find_if(begin(bucket), end(bucket), eq_key);
-		if (first == end(bucket))
-			return {first, first}; // ret empty
-		auto last = std::find_if_not(next(first), end(bucket), eq_key);
-		return {first, last};
-	}
-
-	auto bucket_count() const -> size_type { return data.size(); }
-	auto bucket_data(size_type i) const { return Subrange(data[i]); }
+		auto first = &elements[s.first];
+		if (first->first != key)
+			return {};
+		return {first, first + s.count};
+	}
+
+	auto bucket_count() const -> size_type { return elements.size(); }
+	auto bucket_data(size_type i) const
+	{
+		auto p = &elements[i];
+		return Subrange(p, p + 1);
+	}
+};
+
+/**
+ * @internal
+ * @brief Blocked Bloom filter of strings.
+ *
+ * The filter is an array of blocks of 64 bytes, one cache line each. A key
+ * selects one block with the high half of its hash and sets one bit in each of
+ * the eight 64-bit words of the block, chosen by multiplying the low half of
+ * the hash with eight odd constants. A query reads only one cache line. With
+ * 12 bits per key about 0.4% of the queries for absent keys return true.
+ *
+ * A default constructed filter has no blocks and returns true for every key.
+ * The blocks depend on std::hash. They can be saved and later viewed in place.
+ */
+class Bloom_Filter {
+      public:
+	struct alignas(64) Block {
+		uint64_t words[8];
+	};
+
+      private:
+	Mappable_Array<Block> blocks;
+
+	auto block_of(uint64_t hash) const -> size_t
+	{
+		return (hash >> 32) * uint64_t(blocks.size()) >> 32;
+	}
+	static auto bit_of(uint64_t hash, size_t i) -> uint64_t
+	{
+		constexpr uint32_t salt[8] = {0x47b6137b, 0x44974d91,
+		                              0x8824ad5b, 0xa2b7289d,
+		                              0x705495c7, 0x2df1424b,
+		                              0x9efc4947, 0x5c6bfb31};
+		return uint64_t(1) << (uint32_t(uint32_t(hash) * salt[i]) >> 26);
+	}
+
+      public:
+	Bloom_Filter() = default;
+	explicit Bloom_Filter(size_t num_keys, size_t bits_per_key = 12)
+	    : blocks(std::vector<Block>(
+	          std::max(num_keys * bits_per_key / 512, size_t(1))))
+	{
+	}
+	explicit Bloom_Filter(Mappable_Array<Block>&& b) : blocks(std::move(b))
+	{
+	}
+
+	auto empty() const noexcept { return blocks.empty(); }
+	auto get_blocks() const noexcept -> const Mappable_Array<Block>&
+	{
+		return blocks;
+	}
+	auto insert(std::string_view key) -> void
+	{
+		auto hash = mix_hash(std::hash<std::string_view>()(key));
+		auto& b = blocks.make_owned()[block_of(hash)];
+		for (size_t i = 0; i != 8; ++i)
+			b.words[i] |= bit_of(hash, i);
+	}
+	auto might_contain(std::string_view key) const -> bool
+	{
+		return might_contain_hash(std::hash<std::string_view>()(key));
+	}
+	/**
+	 * @brief Queries the filter with a precomputed hash.
+	 * @param key_hash hash of the key computed with std::hash
+	 */
+	auto might_contain_hash(size_t key_hash) const -> bool
+	{
+		if (blocks.empty())
+			return true;
+		auto hash = mix_hash(key_hash);
+		auto& b = blocks[block_of(hash)];
+		auto ret = true;
+		for (size_t i = 0; i != 8; ++i)
+			ret &= (b.words[i] & bit_of(hash, i)) != 0;
+		return ret;
+	}
+};
+
+struct Cache_Statistics; // public, defined in dictionary.hxx
+
+/**
+ * @internal
+ * @brief Bounded thread-safe cache from strings to values.
+ *
+ * The keys are split by hash into shards, each with its own mutex, so that
+ * concurrent callers rarely wait for each other. Each entry has a charge, e.g.
+ * 1 to bound the number of entries or its size in bytes to bound the memory,
+ * and the total charge of each shard is bounded.
+ *
+ * Entries are evicted with the generalized CLOCK algorithm, an approximation
+ * of LRU. Each entry has a weight, the cost of recomputing its value, and a
+ * credit that is refilled to the weight on every hit. A hand sweeps over the
+ * entries and decrements the credits until it finds an entry without credit,
+ * which is then evicted. Costly entries thus survive more sweeps. With weight
+ * 1 this is the classic CLOCK with a single reference bit.
+ */
+template <class T>
+class Clock_Cache {
+	struct Entry {
+		std::string key;
+		T value;
+		size_t charge;
+		unsigned weight;
+		unsigned credit;
+	};
+	struct Shard {
+		std::mutex mtx;
+		// The keys of the index point into the entries.
+		std::unordered_map<std::string_view, std::unique_ptr<Entry>>
+		    index;
+		std::vector<Entry*> ring; // in clock order
+		size_t hand = 0;
+		size_t charge = 0;
+		size_t hits = 0;
+		size_t misses = 0;
+		size_t evictions = 0;
+	};
+	static constexpr size_t max_shards = 16;
+	std::unique_ptr<Shard[]> shards;
+	size_t num_shards = 0;
+	size_t shard_capacity = 0;
+
+	auto get_shard(std::string_view key) const -> Shard&
+	{
+		auto hash = mix_hash(std::hash<std::string_view>()(key));
+		return shards[hash % num_shards];
+	}
+
+	auto static evict_one(Shard& sh, const Entry* keep) -> void
+	{
+		for (;;) {
+			auto e = sh.ring[sh.hand];
+			if (e != keep) {
+				if (e->credit == 0)
+					break;
+				--e->credit;
+			}
+			sh.hand = (sh.hand + 1) % size(sh.ring);
+		}
+		auto e = sh.ring[sh.hand];
+		sh.charge -= e->charge;
+		sh.index.erase(e->key);
+		sh.ring[sh.hand] = sh.ring.back();
+		sh.ring.pop_back();
+		if (sh.hand == size(sh.ring))
+			sh.hand = 0;
+		++sh.evictions;
+	}
+
+      public:
+	/**
+	 * @brief Constructs the cache.
+	 * @param capacity maximal total charge of the entries, must not be 0
+	 */
+	explicit Clock_Cache(size_t capacity)
+	{
+		num_shards = std::clamp(capacity / 64, size_t(1), max_shards);
+		shard_capacity = (capacity - 1) / num_shards + 1;
+		shards = std::make_unique<Shard[]>(num_shards);
+	}
+
+	/**
+	 * @brief Looks up a key.
+	 * @param key key
+	 * @param[out] out gets a copy of the cached value if found
+	 * @return true if found
+	 */
+	auto get(std::string_view key, T& out) const -> bool
+	{
+		auto& sh = get_shard(key);
+		auto lock = std::lock_guard<std::mutex>(sh.mtx);
+		auto it = sh.index.find(key);
+		if (it == end(sh.index)) {
+			++sh.misses;
+			return false;
+		}
+		++sh.hits;
+		auto& e = *it->second;
+		e.credit = e.weight;
+		out = e.value;
+		return true;
+	}
+
+	/**
+	 * @brief Inserts a value or replaces the cached value of a key.
+	 *
+	 * Values with charge bigger than the capacity of a shard are not
+	 * cached.
+	 *
+	 * @param key key
+	 * @param value value
+	 * @param charge how much of the capacity the entry takes
+	 * @param weight cost of recomputing the value, at least 1
+	 */
+	auto put(std::string_view key, T value, size_t charge = 1,
+	         unsigned weight = 1) -> void
+	{
+		if (charge > shard_capacity)
+			return;
+		auto& sh = get_shard(key);
+		auto lock = std::lock_guard<std::mutex>(sh.mtx);
+		auto it = sh.index.find(key);
+		auto e = static_cast<Entry*>(nullptr);
+		if (it != end(sh.index)) {
+			e = it->second.get();
+			sh.charge = sh.charge - e->charge + charge;
+			e->value = std::move(value);
+			e->charge = charge;
+			e->weight = weight;
+		}
+		else {
+			auto p = std::make_unique<Entry>(Entry{
+			    std::string(key), std::move(value), charge, weight,
+			    weight - 1});
+			e = p.get();
+			sh.index.emplace(e->key, std::move(p));
+			sh.ring.push_back(e);
+			sh.charge += charge;
+		}
+		// The entry just put is never the one evicted to make room.
+		while (sh.charge > shard_capacity)
+			evict_one(sh, e);
+	}
+
+	/**
+	 * @brief Gets the statistics of the cache.
+	 *
+	 * Stats is a template parameter only because Cache_Statistics is
+	 * complete just in the public header.
+	 */
+	template <class Stats = Cache_Statistics>
+	auto statistics() const -> Stats
+	{
+		auto ret = Stats();
+		ret.capacity = num_shards * shard_capacity;
+		for (size_t i = 0; i != num_shards; ++i) {
+			auto& sh = shards[i];
+			auto lock = std::lock_guard<std::mutex>(sh.mtx);
+			ret.charge += sh.charge;
+			ret.size += size(sh.ring);
+			ret.hits += sh.hits;
+			ret.misses += sh.misses;
+			ret.evictions += sh.evictions;
+		}
+		return ret;
+	}
 };
 
 struct Condition_Exception : public std::runtime_error {
@@ -651,13 +1424,46 @@ struct Condition_Exception : public std::runtime_error {
 /**
  * @internal
  * @brief Minimal regex used as the condition in affix entries.
+ *
+ * The condition is compiled in construct() into one matcher per code point
+ * position. A matcher is a literal code point, any code point (dot) or a
+ * bracket expression. Bracket expressions keep the code points below 256 in a
+ * bitset and the others in a sorted string, so matching a position is a table
+ * lookup or a binary search and the condition text is not parsed again.
  */
 class Condition {
 	using Str = std::string;
 	using Str_View = std::string_view;
 
+	struct Position {
+		enum Type : char { LITERAL, ANY, SET, NOT_SET };
+		Type type = ANY;
+		char32_t cp = 0;
+		uint64_t latin1[4] = {};
+		std::u32string others;
+
+		auto match(char32_t c) const -> bool
+		{
+			switch (type) {
+			case LITERAL:
+				return c == cp;
+			case ANY:
+				return true;
+			default:
+				break;
+			}
+			auto found = false;
+			if (c < 256)
+				found = latin1[c >> 6] >> (c & 63) & 1;
+			else
+				found = std::binary_search(begin(others),
+				                           end(others), c);
+			return found == (type == SET);
+		}
+	};
+
 	Str cond;
-	size_t num_cp = 0;
+	std::vector<Position> positions;
 
 	auto construct() -> void;
 
@@ -678,126 +1484,104 @@ class Condition {
 	auto& operator=(const Str& condition)
 	{
 		cond = condition;
-		num_cp = 0;
 		construct();
 		return *this;
 	}
 	auto& operator=(Str&& condition)
 	{
 		cond = std::move(condition);
-		num_cp = 0;
 		construct();
 		return *this;
 	}
 	auto& operator=(const char* condition)
 	{
 		cond = condition;
-		num_cp = 0;
 		construct();
 		return *this;
 	}
 	auto& str() const { return cond; }
 	auto match_prefix(Str_View s) const -> bool;
-	auto match_suffix(Str_View s) const
-	{
-		auto cp_cnt = size_t(0);
-		auto i = size(s);
-		for (; cp_cnt != num_cp && i != 0; ++cp_cnt) {
-			valid_u8_reverse_index(s, i);
-		}
-		if (cp_cnt != num_cp)
-			return false;
-		return match_prefix(s.substr(i));
-	}
+	auto match_suffix(Str_View s) const -> bool;
 };
 auto inline Condition::construct() -> void
 {
+	positions.clear();
 	for (size_t i = 0; i != size(cond);) {
-		size_t j = cond.find_first_of("[].", i);
-		if (j == cond.npos)
-			j = size(cond);
-		while (i != j) {
-			valid_u8_advance_index(cond, i);
-			++num_cp;
-		}
-		if (i == size(cond))
-			break;
+		auto& p = positions.emplace_back();
 		if (cond[i] == '.') {
-			++num_cp;
 			++i;
 			continue;
 		}
-		else if (cond[i] == ']') {
+		if (cond[i] == ']') {
 			auto what =
 			    "closing bracket has no matching opening bracket";
 			throw Condition_Exception(what);
 		}
-		else if (cond[i] == '[') {
+		if (cond[i] != '[') {
+			p.type = Position::LITERAL;
+			valid_u8_advance_cp(cond, i, p.cp);
+			continue;
+		}
+		++i;
+		if (i == size(cond)) {
+			auto what = "opening bracket has no matching "
+			            "closing bracket";
+			throw Condition_Exception(what);
+		}
+		p.type = Position::SET;
+		if (cond[i] == '^') {
+			p.type = Position::NOT_SET;
 			++i;
-			if (i == size(cond)) {
-				auto what = "opening bracket has no matching "
-				            "closing bracket";
-				throw Condition_Exception(what);
-			}
-			if (cond[i] == '^')
-				++i;
-			j = cond.find(']', i);
-			if (j == i) {
-				auto what = "empty bracket expression";
-				throw Condition_Exception(what);
-			}
-			if (j == cond.npos) {
-				auto what = "opening bracket has no matching "
-				            "closing bracket";
-				throw Condition_Exception(what);
-			}
-			++num_cp;
-			i = j + 1;
 		}
+		auto j = cond.find(']', i);
+		if (j == i) {
+			auto what = "empty bracket expression";
+			throw Condition_Exception(what);
+		}
+		if (j == cond.npos) {
+			auto what = "opening bracket has no matching "
+			            "closing bracket";
+			throw Condition_Exception(what);
+		}
+		while (i != j) {
+			char32_t cp;
+			valid_u8_advance_cp(cond, i, cp);
+			if (cp < 256)
+				p.latin1[cp >> 6] |= uint64_t(1) << (cp & 63);
+			else
+				p.others += cp;
+		}
+		std::sort(begin(p.others), end(p.others));
+		i = j + 1;
 	}
 }
 
 auto inline Condition::match_prefix(Str_View s) const -> bool
 {
-	if (size(s) < num_cp)
-		return false;
+	auto i = size_t(0);
+	for (auto& p : positions) {
+		if (i == size(s))
+			return false;
+		char32_t cp;
+		valid_u8_advance_cp(s, i, cp);
+		if (!p.match(cp))
+			return false;
+	}
+	return true;
+}
 
-	auto s_i = size_t(0);
-	auto cond_i = size_t(0);
-	for (; s_i != size(s) && cond_i != size(cond); ++cond_i) {
-		auto s_cu = s[s_i];
-		auto cond_cu = cond[cond_i];
-		switch (cond_cu) {
-		default:
-			if (s_cu != cond_cu)
-				return false;
-			++s_i;
-			break;
-		case '.':
-			valid_u8_advance_index(s, s_i);
-			break;
-		case '[':
-			++cond_i;
-			cond_cu = cond[cond_i];
-			if (cond_cu == '^')
-				++cond_i;
-			char32_t str_cp;
-			valid_u8_advance_cp(s, s_i, str_cp);
-			auto found = false;
-			while (cond[cond_i] != ']') {
-				char32_t cond_cp;
-				valid_u8_advance_cp(cond, cond_i, cond_cp);
-				if (str_cp == cond_cp)
-					found = true;
-			}
-			if (cond_cu != '^' && !found)
-				return false;
-			if (cond_cu == '^' && found)
-				return false;
-			break;
-		}
+auto inline Condition::match_suffix(Str_View s) const -> bool
+{
+	auto i = size(s);
+	for (auto p = rbegin(positions); p != rend(positions); ++p) {
+		if (i == 0)
+			return false;
+		char32_t cp;
+		valid_u8_reverse_cp(s, i, cp);
+		if (!p->match(cp))
+			return false;
 	}
-	return cond_i == size(cond);
+	return true;
 }
 
 struct Prefix {
@@ -807,7 +1591,7 @@ struct Prefix {
 	bool cross_product = false;
 	Str stripping;
 	Str appending;
-	Flag_Set cont_flags;
+	Flag_Set_With_Roles cont_flags;
 	Condition condition;
 
 	auto to_root(Str& word) const -> Str&
@@ -830,7 +1614,7 @@ struct Prefix {
 		return word;
 	}
 
-	auto check_condition(const Str& word) const -> bool
+	auto check_condition(std::string_view word) const -> bool
 	{
 		return condition.match_prefix(word);
 	}
@@ -843,7 +1627,7 @@ struct Suffix {
 	bool cross_product = false;
 	Str stripping;
 	Str appending;
-	Flag_Set cont_flags;
+	Flag_Set_With_Roles cont_flags;
 	Condition condition;
 
 	auto to_root(Str& word) const -> Str&
@@ -868,12 +1652,24 @@ struct Suffix {
 		return word;
 	}
 
-	auto check_condition(const Str& word) const -> bool
+	auto check_condition(std::string_view word) const -> bool
 	{
 		return condition.match_suffix(word);
 	}
 };
 
+/**
+ * @internal
+ * @brief Multiset of strings (or objects with string keys) that can find all
+ * elements whose key is a prefix of a given word.
+ *
+ * The elements are kept sorted by key and a trie of the keys is built over
+ * them. The elements with the key that is the path to a trie node are a
+ * contiguous range of the sorted array. Finding the elements is one pass over
+ * the word that follows the trie edges and reports the range of each visited
+ * node, shorter keys first. With a key transformation that reverses the
+ * strings, the trie is over reversed keys and finds suffixes.
+ */
 template <class T, class Key_Extr = identity, class Key_Transform = identity>
 class Prefix_Multiset {
       public:
@@ -893,8 +1689,16 @@ class Prefix_Multiset {
 	struct Ebo : public Ebo_Key_Extr, Ebo_Key_Transf {
 		Vector_Type table;
 	} ebo;
-	std::basic_string<Char_Type> first_letter;
-	std::vector<size_t> prefix_idx_with_first_letter;
+	struct Node {
+		// range of elements in the table with key equal to the path
+		uint32_t first_elem = 0;
+		uint32_t last_elem = 0;
+		// range of children in nodes
+		uint32_t first_child = 0;
+		uint32_t num_children = 0;
+	};
+	std::vector<Node> nodes;             // nodes[0] is the root
+	std::basic_string<Char_Type> labels; // labels[i] is the edge to nodes[i]
 
 	auto key_extractor() const -> const Ebo_Key_Extr& { return ebo; }
 	auto key_transformator() const -> const Ebo_Key_Transf& { return ebo; }
@@ -907,48 +1711,73 @@ class Prefix_Multiset {
 		auto& transform_key = key_transformator();
 		auto& table = get_table();
 
-		std::sort(begin(table), end(table), [&](T& a, T& b) {
+		auto key_less = [&](auto& a, auto& b) {
 			auto&& key_a = transform_key(extract_key(a));
 			auto&& key_b = transform_key(extract_key(b));
 			return key_a < key_b;
-		});
-
-		first_letter.clear();
-		prefix_idx_with_first_letter.clear();
-		auto first = begin(table);
-		auto last = end(table);
-		auto it = std::find_if_not(first, last, [=](const T& x) {
-			auto&& k = transform_key(extract_key(x));
-			return k.empty();
-		});
-		while (it != last) {
-			auto&& k1 = transform_key(extract_key(*it));
-			first_letter.push_back(k1[0]);
-			prefix_idx_with_first_letter.push_back(it - first);
-
-			it = std::upper_bound(
-			    it, last, k1[0],
-			    Comparator{0, extract_key, transform_key});
-		}
-		if (!prefix_idx_with_first_letter.empty())
-			prefix_idx_with_first_letter.push_back(last - first);
+		};
+		std::stable_sort(begin(table), end(table), key_less);
+
+		nodes.assign(1, Node());
+		labels.assign(1, Char_Type());
+		build_node(0, 0, table.size(), 0);
 	}
 
-	struct Comparator {
-		size_t i;
-		Key_Extr extract_key;
-		Key_Transform transform_key;
-		auto operator()(const T& a, Char_Type b) const
-		{
-			auto&& key_a = transform_key(extract_key(a));
-			return Traits::lt(key_a[i], b);
+	/**
+	 * @brief Builds the subtrie of a node.
+	 * @param n index of the node
+	 * @param first index of the first element with the node's prefix
+	 * @param last index past the last element with the node's prefix
+	 * @param depth length of the node's prefix
+	 */
+	auto build_node(size_t n, size_t first, size_t last, size_t depth)
+	    -> void
+	{
+		auto& extract_key = key_extractor();
+		auto& transform_key = key_transformator();
+		auto& table = get_table();
+		auto key_len = [&](size_t i) {
+			return transform_key(extract_key(table[i])).size();
+		};
+		auto key_char = [&](size_t i) {
+			return transform_key(extract_key(table[i]))[depth];
+		};
+
+		auto i = first;
+		while (i != last && key_len(i) == depth)
+			++i;
+		nodes[n].first_elem = first;
+		nodes[n].last_elem = i;
+
+		// first pass creates the children, they must be contiguous
+		auto children = std::vector<std::pair<size_t, size_t>>();
+		while (i != last) {
+			auto c = key_char(i);
+			auto j = i + 1;
+			while (j != last && Traits::eq(key_char(j), c))
+				++j;
+			children.emplace_back(i, j);
+			i = j;
 		}
-		auto operator()(Char_Type a, const T& b) const
-		{
-			auto&& key_b = transform_key(extract_key(b));
-			return Traits::lt(a, key_b[i]);
+		nodes[n].first_child = nodes.size();
+		nodes[n].num_children = children.size();
+		for (auto& ch : children) {
+			nodes.emplace_back();
+			labels.push_back(key_char(ch.first));
 		}
-	};
+		for (size_t k = 0; k != children.size(); ++k) {
+			auto [a, b] = children[k];
+			build_node(nodes[n].first_child + k, a, b, depth + 1);
+		}
+	}
+
+	auto child(size_t n, Char_Type c) const -> size_t
+	{
+		auto& nd = nodes[n];
+		auto p = Traits::find(&labels[nd.first_child], nd.num_children,
+		                      c);
+		return p ? p - labels.data() : 0;
+	}
 
       public:
 	Prefix_Multiset() = default;
@@ -1009,6 +1838,7 @@ class Prefix_Multiset {
 		Iterator it = {};
 		Iterator last = {};
 		const Key_Type* search_key = {};
+		size_t node = {};
 		size_t len = {};
 		bool valid = false;
 
@@ -1025,10 +1855,13 @@ class Prefix_Multiset {
 		Iter_Prefixes_Of() = default;
 		Iter_Prefixes_Of(const Prefix_Multiset& set,
 		                 const Key_Type& word)
-		    : set(&set), it(set.get_table().begin()),
-		      last(set.get_table().end()), search_key(&word),
-		      valid(true)
+		    : set(&set), search_key(&word), valid(!set.nodes.empty())
 		{
+			if (!valid)
+				return;
+			auto first = set.get_table().begin();
+			it = first + set.nodes[0].first_elem;
+			last = first + set.nodes[0].last_elem;
 			advance();
 		}
 		Iter_Prefixes_Of(const Prefix_Multiset&, Key_Type&&) = delete;
@@ -1074,55 +1907,21 @@ template <class T, class Key_Extr, class Key_Transform>
 auto Prefix_Multiset<T, Key_Extr, Key_Transform>::Iter_Prefixes_Of::advance()
     -> void
 {
-	auto& extract_key = set->key_extractor();
-	auto& transform_key = set->key_transformator();
-	auto& table = set->get_table();
-
-	if (len == 0) {
-		if (it != last) {
-			if (transform_key(extract_key(*it)).empty())
-				return;
-			if (transform_key(*search_key).empty()) {
-				valid = false;
-				return;
-			}
-
-			auto& first_letter = set->first_letter;
-			auto& prefix_idx_with_first_letter =
-			    set->prefix_idx_with_first_letter;
-			auto idx =
-			    first_letter.find(transform_key(*search_key)[0]);
-			if (idx == first_letter.npos) {
-				valid = false;
-				return;
-			}
-
-			auto first = table.begin();
-			it = first + prefix_idx_with_first_letter[idx];
-			last = first + prefix_idx_with_first_letter[idx + 1];
-			++len;
-		}
-		else {
+	auto&& key = set->key_transformator()(*search_key);
+	while (it == last) {
+		if (len == key.size()) {
 			valid = false;
 			return;
 		}
-	}
-	for (;; ++len) {
-		if (it != last) {
-			if (transform_key(extract_key(*it)).size() == len)
-				return;
-			if (len == transform_key(*search_key).size()) {
-				valid = false;
-				break;
-			}
-		}
-		else {
+		node = set->child(node, key[len]);
+		if (node == 0) {
 			valid = false;
-			break;
+			return;
 		}
-		tie(it, last) =
-		    equal_range(it, last, transform_key(*search_key)[len],
-		                Comparator{len, extract_key, transform_key});
+		++len;
+		auto first = set->get_table().begin();
+		it = first + set->nodes[node].first_elem;
+		last = first + set->nodes[node].last_elem;
 	}
 }
 
@@ -1131,46 +1930,19 @@ template <class Func>
 auto Prefix_Multiset<T, Key_Extr, Key_Transform>::for_each_prefixes_of(
     const Key_Type& word, Func func) const
 {
-	auto& extract_key = key_extractor();
-	auto& transform_key = key_transformator();
-	auto& table = get_table();
-
-	auto first = begin(table);
-	auto last = end(table);
-	auto it = first;
-	for (; it != last; ++it) {
-		auto&& k = transform_key(extract_key(*it));
-		if (k.empty())
-			func(*it);
-		else
-			break;
-	}
-
-	if (it == last)
+	if (nodes.empty())
 		return;
-	if (transform_key(word).empty())
-		return;
-
-	auto idx = first_letter.find(transform_key(word)[0]);
-	if (idx == first_letter.npos)
-		return;
-	first = begin(table) + prefix_idx_with_first_letter[idx];
-	last = begin(table) + prefix_idx_with_first_letter[idx + 1];
-
-	for (size_t len = 1;; ++len) {
-		it = first;
-		for (; it != last &&
-		       transform_key(extract_key(*it)).size() == len;
-		     ++it) {
-			func(*it);
-		}
-		if (it == last)
+	auto&& key = key_transformator()(word);
+	auto& table = get_table();
+	for (size_t n = 0, len = 0;; ++len) {
+		auto& nd = nodes[n];
+		for (auto i = nd.first_elem; i != nd.last_elem; ++i)
+			func(table[i]);
+		if (len == key.size())
 			break;
-		if (len == transform_key(word).size())
+		n = child(n, key[len]);
+		if (n == 0)
 			break;
-		tie(first, last) =
-		    equal_range(it, last, transform_key(word)[len],
-		                Comparator{len, extract_key, transform_key});
 	}
 }
 
@@ -1409,6 +2181,7 @@ class Compound_Rule_Table {
 		return *this;
 	}
 	auto empty() const { return rules.empty(); }
+	auto& data() const { return rules; }
 	auto has_any_of_flags(const Flag_Set& f) const -> bool;
 	auto match_any_rule(const std::vector<const Flag_Set*>& data) const
 	    -> bool;
@@ -1831,6 +2604,6 @@ auto inline Phonetic_Table::replace(Str& word) const -> bool
 	}
 	return ret;
 }
-} // namespace v5
+} // namespace v6
 } // namespace nuspell
 #endif // NUSPELL_STRUCTURES_HXX
@@ -17,13 +17,57 @@
  */
 
 #include "suggester.hxx"
+#include "dictionary.hxx"
 #include "utils.hxx"
 #include <unicode/uchar.h>
 
 using namespace std;
 
 namespace nuspell {
-inline namespace v5 {
+inline namespace v6 {
+
+namespace {
+thread_local Suggest_Budget* active_suggest_budget = nullptr;
+} // namespace
+
+/**
+ * @internal
+ * @brief Gets the Suggest_Budget installed by Suggest_Budget_Scope, if any.
+ */
+auto current_suggest_budget() -> Suggest_Budget*
+{
+	return active_suggest_budget;
+}
+
+Suggest_Budget_Scope::Suggest_Budget_Scope(Suggest_Budget& budget)
+    : old(active_suggest_budget)
+{
+	active_suggest_budget = &budget;
+}
+
+Suggest_Budget_Scope::~Suggest_Budget_Scope() { active_suggest_budget = old; }
+
+/**
+ * @internal
+ * @brief Charges @p work candidates to the current Suggest_Budget.
+ * @return true if the budget is exhausted and the search must stop
+ */
+auto static suggest_budget_exhausted(size_t work = 1) -> bool
+{
+	auto budget = active_suggest_budget;
+	if (!budget)
+		return false;
+	if (budget->truncated)
+		return true;
+	if (budget->max_work - budget->work < work ||
+	    (budget->deadline != chrono::steady_clock::time_point::max() &&
+	     chrono::steady_clock::now() >= budget->deadline)) {
+		budget->truncated = true;
+		return true;
+	}
+	budget->work += work;
+	return false;
+}
 
 auto static insert_sug_first(const string& word, List_Strings& out)
 {
@@ -42,7 +86,9 @@ auto Suggester::suggest_priv(string_view input_word, List_Strings& out) const
 {
 	if (empty(input_word))
 		return;
-	auto word = string(input_word);
+	auto word_buf = Scratch<string>();
+	auto& word = *word_buf;
+	word = input_word;
 	input_substr_replacer.replace(word);
 	auto abbreviation = word.back() == '.';
 	if (abbreviation) {
@@ -53,7 +99,8 @@ auto Suggester::suggest_priv(string_view input_word, List_Strings& out) const
 		if (word.empty())
 			return;
 	}
-	auto buffer = string();
+	auto buffer_buf = Scratch<string>();
+	auto& buffer = *buffer_buf;
 	auto casing = classify_casing(word);
 	auto hq_sugs = High_Quality_Sugs();
 	switch (casing) {
@@ -148,7 +195,8 @@ auto Suggester::suggest_priv(string_view input_word, List_Strings& out) const
 		    return s.find('-') != s.npos;
 	    });
 	if (has_dash && !has_dash_sug) {
-		auto sugs_tmp = List_Strings();
+		auto sugs_tmp_buf = Scratch<List_Strings>();
+		auto& sugs_tmp = *sugs_tmp_buf;
 		auto i = size_t();
 		for (;;) {
 			auto j = word.find('-', i);
@@ -160,7 +208,7 @@ auto Suggester::suggest_priv(string_view input_word, List_Strings& out) const
 					buffer.replace(i, j - i, t);
 					auto flg = check_word(buffer);
 					if (!flg ||
-					    !flg->contains(forbiddenword_flag))
+					    !(flg->roles & ROLE_FORBIDDENWORD))
 						out.push_back(buffer);
 				}
 			}
@@ -241,12 +289,14 @@ auto Suggester::suggest_low(std::string& word, List_Strings& out) const
 auto Suggester::add_sug_if_correct(std::string& word, List_Strings& out) const
     -> bool
 {
+	if (suggest_budget_exhausted())
+		return false;
 	auto res = check_word(word, FORBID_BAD_FORCEUCASE, SKIP_HIDDEN_HOMONYM);
 	if (!res)
 		return false;
-	if (res->contains(forbiddenword_flag))
+	if (res->roles & ROLE_FORBIDDENWORD)
 		return false;
-	if (forbid_warn && res->contains(warn_flag))
+	if (forbid_warn && (res->roles & ROLE_WARN))
 		return false;
 	out.push_back(word);
 	return true;
@@ -312,9 +362,10 @@ auto Suggester::try_rep_suggestion(std::string& word, List_Strings& out) const
 
 	auto i = size_t(0);
 	auto j = word.find(' ');
-	if (j == word.npos)
+	if (j == word.npos || suggest_budget_exhausted())
 		return;
-	auto part = string();
+	auto part_buf = Scratch<string>();
+	auto& part = *part_buf;
 	for (; j != word.npos; i = j + 1, j = word.find(' ', i)) {
 		part.assign(word, i, j - i);
 		if (!check_word(part, FORBID_BAD_FORCEUCASE,
@@ -710,11 +761,13 @@ auto Suggester::two_words_suggest(const std::string& word,
 		return;
 
 	auto w1_num_cp = size_t(0);
-	auto word1 = string();
-	auto word2 = string();
+	auto word1_buf = Scratch<string>();
+	auto word2_buf = Scratch<string>();
+	auto& word1 = *word1_buf;
+	auto& word2 = *word2_buf;
 	for (size_t i = 0, next_i = 0;; i = next_i, ++w1_num_cp) {
 		valid_u8_advance_index(word, next_i);
-		if (next_i == size(word))
+		if (next_i == size(word) || suggest_budget_exhausted())
 			break;
 		word1.append(word, i, next_i - i);
 		// TODO: maybe switch to check_word()
@@ -742,8 +795,14 @@ auto Suggester::two_words_suggest(const std::string& word,
 	}
 }
 
-namespace {
-auto ngram_similarity_low_level(size_t n, u32string_view a, u32string_view b)
+/**
+ * @internal
+ * @brief Scores the similarity of two strings by their common k-grams
+ *
+ * Same as ngram_similarity_low_level(), but searches @p b for each k-gram.
+ * Used for the strings that are too long for the bitmasks.
+ */
+auto ngram_similarity_by_find(size_t n, u32string_view a, u32string_view b)
     -> ptrdiff_t
 {
 	auto score = ptrdiff_t(0);
@@ -762,8 +821,16 @@ auto ngram_similarity_low_level(size_t n, u32string_view a, u32string_view b)
 	}
 	return score;
 }
-auto ngram_similarity_weighted_low_level(size_t n, u32string_view a,
-                                         u32string_view b) -> ptrdiff_t
+
+/**
+ * @internal
+ * @brief Scores the similarity of two strings by their common k-grams
+ *
+ * Same as ngram_similarity_weighted_low_level(), but searches @p b for each
+ * k-gram. Used for the strings that are too long for the bitmasks.
+ */
+auto ngram_similarity_weighted_by_find(size_t n, u32string_view a,
+                                       u32string_view b) -> ptrdiff_t
 {
 	auto score = ptrdiff_t(0);
 	n = min(n, a.size());
@@ -786,6 +853,56 @@ auto ngram_similarity_weighted_low_level(size_t n, u32string_view a,
 	return score;
 }
 
+namespace {
+/**
+ * @internal
+ * @brief Bitmasks of the positions of each character in a string.
+ *
+ * Bit j of the mask of a character is set if the string has it at position
+ * j, so the string can have at most 64 characters. The masks are kept in a
+ * small open addressing hash table with at least twice as many slots as
+ * characters. Empty slots are the ones with zero mask.
+ */
+class Char_Position_Masks {
+	static constexpr size_t max_slots = 128;
+	char32_t keys[max_slots];
+	uint64_t masks[max_slots];
+	unsigned shift;
+	size_t slot_mask;
+
+	auto slot_of(char32_t c) const -> size_t
+	{
+		auto i = size_t((uint32_t(c) * 0x9E3779B1u) >> shift);
+		while (masks[i] != 0 && keys[i] != c)
+			i = (i + 1) & slot_mask;
+		return i;
+	}
+
+      public:
+	static constexpr size_t max_length = 64;
+
+	explicit Char_Position_Masks(u32string_view s)
+	{
+		// Only as many slots as needed are cleared, short strings
+		// are common.
+		auto bits = 4u;
+		while ((size_t(1) << bits) < 2 * s.size())
+			++bits;
+		shift = 32 - bits;
+		slot_mask = (size_t(1) << bits) - 1;
+		fill_n(masks, slot_mask + 1, 0);
+		for (size_t j = 0; j != s.size(); ++j) {
+			auto i = slot_of(s[j]);
+			keys[i] = s[j];
+			masks[i] |= uint64_t(1) << j;
+		}
+	}
+	auto operator[](char32_t c) const -> uint64_t
+	{
+		return masks[slot_of(c)];
+	}
+};
+
 auto ngram_similarity_longer_worse(size_t n, u32string_view a, u32string_view b)
     -> ptrdiff_t
 {
@@ -830,9 +947,8 @@ auto left_common_substring_length(u32string_view a, u32string_view b)
 	auto it = std::mismatch(begin(a) + 1, end(a), begin(b) + 1, end(b));
 	return it.first - begin(a);
 }
-auto longest_common_subsequence_length(u32string_view a, u32string_view b,
-                                       vector<size_t>& state_buffer)
-    -> ptrdiff_t
+auto lcs_length_dp(u32string_view a, u32string_view b,
+                   vector<size_t>& state_buffer) -> ptrdiff_t
 {
 	state_buffer.assign(b.size(), 0);
 	auto row1_prev = size_t(0);
@@ -853,6 +969,39 @@ auto longest_common_subsequence_length(u32string_view a, u32string_view b,
 	}
 	return ptrdiff_t(row1_prev);
 }
+
+auto count_set_bits(uint64_t x) -> ptrdiff_t
+{
+#if defined(__GNUC__)
+	return __builtin_popcountll(x);
+#else
+	x = x - ((x >> 1) & 0x5555555555555555);
+	x = (x & 0x3333333333333333) + ((x >> 2) & 0x3333333333333333);
+	x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0F;
+	return ptrdiff_t((x * 0x0101010101010101) >> 56);
+#endif
+}
+
+/**
+ * @internal
+ * @brief Computes the length of the LCS with the bit-parallel algorithm.
+ *
+ * This is the algorithm of Allison and Dix as improved by Hyyrö. Bit j of
+ * the state is for the character b[j], so @p b must not be longer than 64.
+ */
+auto lcs_length_bit_parallel(u32string_view a, u32string_view b)
+    -> ptrdiff_t
+{
+	auto b_masks = Char_Position_Masks(b);
+	auto v = ~uint64_t(0);
+	for (auto c : a) {
+		auto u = v & b_masks[c];
+		v = (v + u) | (v - u);
+	}
+	auto used_bits = ~uint64_t(0) >> (64 - b.size());
+	return count_set_bits(~v & used_bits);
+}
+
 struct Count_Eq_Chars_At_Same_Pos_Result {
 	ptrdiff_t num;
 	bool is_swap;
@@ -876,57 +1025,487 @@ auto count_eq_chars_at_same_pos(u32string_view a, u32string_view b)
 	}
 	return {ptrdiff_t(count), is_swap};
 }
-struct Word_Entry_And_Score {
-	Word_List::const_pointer word_entry = {};
-	ptrdiff_t score = {};
-	[[maybe_unused]] auto operator<(const Word_Entry_And_Score& rhs) const
-	{
-		return score > rhs.score; // Greater than
+} // namespace
+
+/**
+ * @internal
+ * @brief Scores the similarity of two strings by their common k-grams
+ *
+ * For each k from 1 to @p n, counts the k-grams of @p a that occur in @p b,
+ * and stops after the first k with less than two.
+ */
+auto ngram_similarity_low_level(size_t n, u32string_view a, u32string_view b)
+    -> ptrdiff_t
+{
+	using Masks = Char_Position_Masks;
+	if (a.size() > Masks::max_length || b.size() > Masks::max_length)
+		return ngram_similarity_by_find(n, a, b);
+	// Bit j of matches[i] is set if the k-gram at position i in a occurs
+	// at position j in b.
+	auto b_masks = Masks(b);
+	uint64_t a_masks[Masks::max_length];
+	uint64_t matches[Masks::max_length];
+	for (size_t i = 0; i != a.size(); ++i)
+		matches[i] = a_masks[i] = b_masks[a[i]];
+	auto score = ptrdiff_t(0);
+	n = min(n, a.size());
+	for (size_t k = 1; k != n + 1; ++k) {
+		auto k_score = ptrdiff_t(0);
+		for (size_t i = 0; i != a.size() - k + 1; ++i) {
+			matches[i] &= a_masks[i + k - 1] >> (k - 1);
+			k_score += matches[i] != 0;
+		}
+		score += k_score;
+		if (k_score < 2)
+			break;
 	}
-};
-struct Word_And_Score {
-	u32string word = {};
-	ptrdiff_t score = {};
-	[[maybe_unused]] auto operator<(const Word_And_Score& rhs) const
-	{
-		return score > rhs.score; // Greater than
+	return score;
+}
+
+/**
+ * @internal
+ * @brief Scores the similarity of two strings by their common k-grams
+ *
+ * For each k from 1 to @p n, adds one for each k-gram of @p a that occurs in
+ * @p b and subtracts one for the others, two for the first and the last.
+ */
+auto ngram_similarity_weighted_low_level(size_t n, u32string_view a,
+                                         u32string_view b) -> ptrdiff_t
+{
+	using Masks = Char_Position_Masks;
+	if (a.size() > Masks::max_length || b.size() > Masks::max_length)
+		return ngram_similarity_weighted_by_find(n, a, b);
+	auto b_masks = Masks(b);
+	uint64_t a_masks[Masks::max_length];
+	uint64_t matches[Masks::max_length];
+	for (size_t i = 0; i != a.size(); ++i)
+		matches[i] = a_masks[i] = b_masks[a[i]];
+	auto score = ptrdiff_t(0);
+	n = min(n, a.size());
+	for (size_t k = 1; k != n + 1; ++k) {
+		auto last = a.size() - k;
+		for (size_t i = 0; i != last + 1; ++i) {
+			matches[i] &= a_masks[i + k - 1] >> (k - 1);
+			if (matches[i] != 0)
+				++score;
+			else
+				score -= 1 + (i == 0 || i == last);
+		}
 	}
-};
-} // namespace
+	return score;
+}
 
-auto Suggester::ngram_suggest(const std::string& word_u8,
-                              List_Strings& out) const -> void
+/**
+ * @internal
+ * @brief Computes the length of the longest common subsequence of two strings
+ *
+ * When either string has at most 64 characters the bit-parallel algorithm is
+ * used, otherwise the dynamic programming one.
+ *
+ * @param state_buffer the buffer for the dynamic programming algorithm
+ */
+auto longest_common_subsequence_length(u32string_view a, u32string_view b,
+                                       vector<size_t>& state_buffer)
+    -> ptrdiff_t
+{
+	if (a.empty() || b.empty())
+		return 0;
+	if (b.size() <= 64)
+		return lcs_length_bit_parallel(a, b);
+	if (a.size() <= 64)
+		return lcs_length_bit_parallel(b, a);
+	return lcs_length_dp(a, b, state_buffer);
+}
+
+auto static is_ngram_root(Word_List::const_reference word_entry) -> bool
+{
+	auto& flags = *word_entry.second;
+	return !(flags.roles & (ROLE_FORBIDDENWORD | ROLE_HIDDEN_HOMONYM |
+	                        ROLE_NOSUGGEST | ROLE_ONLYINCOMPOUND));
+}
+
+/**
+ * @internal
+ * @brief Fills the Ngram_Image with the roots that ngram_suggest() scans.
+ */
+auto Suggester::build_ngram_image(Ngram_Image& image) const -> void
 {
-	auto const wrong_word = valid_utf8_to_32(word_u8);
-	auto wide_buf = u32string();
-	auto roots = vector<Word_Entry_And_Score>();
 	auto dict_word = u32string();
+	auto lower = u32string();
 	for (size_t bucket = 0; bucket != words.bucket_count(); ++bucket) {
 		for (auto& word_entry : words.bucket_data(bucket)) {
-			auto& [dict_word_u8, flags] = word_entry;
-			if (flags.contains(forbiddenword_flag) ||
-			    flags.contains(HIDDEN_HOMONYM_FLAG) ||
-			    flags.contains(nosuggest_flag) ||
-			    flags.contains(compound_onlyin_flag))
+			if (!is_ngram_root(word_entry))
 				continue;
-			valid_utf8_to_32(dict_word_u8, dict_word);
-			auto score =
-			    left_common_substring_length(wrong_word, dict_word);
-			auto& lower_dict_word = wide_buf;
-			to_lower(dict_word, icu_locale, lower_dict_word);
-			score += ngram_similarity_longer_worse(3, wrong_word,
-			                                       lower_dict_word);
-			if (roots.size() != 100) {
-				roots.push_back({&word_entry, score});
-				push_heap(begin(roots), end(roots));
+			valid_utf8_to_32(word_entry.first, dict_word);
+			to_lower(dict_word, icu_locale, lower);
+			auto e = Ngram_Image::Entry();
+			e.word_entry = &word_entry;
+			e.lower_begin = uint32_t(size(image.chars));
+			e.lower_size = uint32_t(size(lower));
+			image.chars += lower;
+			e.word_begin = e.lower_begin;
+			e.word_size = e.lower_size;
+			if (dict_word != lower) {
+				e.word_begin = uint32_t(size(image.chars));
+				e.word_size = uint32_t(size(dict_word));
+				image.chars += dict_word;
+			}
+			image.entries.push_back(e);
+		}
+	}
+	image.chars.shrink_to_fit();
+	image.entries.shrink_to_fit();
+}
+
+auto static trigram_key(u32string_view s, size_t i) -> uint64_t
+{
+	// Code points have 21 bits, three of them fit in 64 bits.
+	return uint64_t(s[i]) << 42 | uint64_t(s[i + 1]) << 21 | s[i + 2];
+}
+
+/**
+ * @internal
+ * @brief Builds the inverted index from trigrams to entries.
+ */
+auto Ngram_Image::build_index() -> void
+{
+	auto pairs = vector<pair<uint64_t, uint32_t>>();
+	for (size_t i = 0; i != size(entries); ++i) {
+		auto w = lower(entries[i]);
+		for (size_t j = 0; j + 3 <= size(w); ++j)
+			pairs.emplace_back(trigram_key(w, j), uint32_t(i));
+	}
+	sort(begin(pairs), end(pairs));
+	pairs.erase(unique(begin(pairs), end(pairs)), end(pairs));
+	trigrams.clear();
+	trigram_offsets.clear();
+	postings.clear();
+	postings.reserve(size(pairs));
+	for (size_t i = 0; i != size(pairs); ++i) {
+		if (i == 0 || pairs[i].first != pairs[i - 1].first) {
+			trigrams.push_back(pairs[i].first);
+			trigram_offsets.push_back(uint32_t(i));
+		}
+		postings.push_back(pairs[i].second);
+	}
+	trigram_offsets.push_back(uint32_t(size(postings)));
+}
+
+/**
+ * @internal
+ * @brief Finds the entries that share at least one trigram with a word.
+ *
+ * Gives up if the posting lists of the trigrams of the word hold more than
+ * @p max_size entries in total, as then scoring the candidates would not be
+ * much cheaper than scanning all entries.
+ *
+ * @param word word
+ * @param[out] out indexes of the entries, in ascending order
+ * @param max_size maximal total size of the posting lists
+ * @return false if it gave up, then @p out is empty
+ */
+auto Ngram_Image::find_candidates(std::u32string_view word,
+                                  std::vector<size_t>& out,
+                                  size_t max_size) const -> bool
+{
+	out.clear();
+	for (size_t j = 0; j + 3 <= size(word); ++j) {
+		auto key = trigram_key(word, j);
+		auto it = lower_bound(begin(trigrams), end(trigrams), key);
+		if (it == end(trigrams) || *it != key)
+			continue;
+		auto t = it - begin(trigrams);
+		auto first = begin(postings) + trigram_offsets[t];
+		auto last = begin(postings) + trigram_offsets[t + 1];
+		if (size_t(last - first) > max_size - size(out)) {
+			out.clear();
+			return false;
+		}
+		out.insert(end(out), first, last);
+	}
+	sort(begin(out), end(out));
+	out.erase(unique(begin(out), end(out)), end(out));
+	return true;
+}
+
+Ngram_Thread_Pool::~Ngram_Thread_Pool() { stop(); }
+
+/**
+ * @internal
+ * @brief Sets the number of threads, including the calling one.
+ *
+ * The running threads are stopped, the new ones are started on first use.
+ */
+auto Ngram_Thread_Pool::set_num_threads(size_t n) -> void
+{
+	auto lock = lock_guard<mutex>(run_mtx);
+	if (n == num_threads)
+		return;
+	stop();
+	num_threads = n;
+}
+
+auto Ngram_Thread_Pool::work(Worker& w, size_t part, size_t seen) -> void
+{
+	auto lock = unique_lock<mutex>(mtx);
+	for (;;) {
+		start_cv.wait(lock,
+		              [&] { return quit || generation != seen; });
+		if (quit)
+			return;
+		seen = generation;
+		if (part < num_parts) {
+			auto t = task;
+			auto data = task_data;
+			auto err = exception_ptr();
+			lock.unlock();
+			try {
+				t(data, part, w.buf1, w.buf2, w.roots);
 			}
-			else if (score > roots.front().score) {
-				pop_heap(begin(roots), end(roots));
-				roots.back() = {&word_entry, score};
-				push_heap(begin(roots), end(roots));
+			catch (...) {
+				err = current_exception();
 			}
+			lock.lock();
+			if (err && !error)
+				error = err;
 		}
+		if (--pending == 0)
+			done_cv.notify_one();
 	}
+}
+
+/**
+ * @internal
+ * @brief Starts the threads, the caller must hold run_mtx.
+ * @return false if they could not be started
+ */
+auto Ngram_Thread_Pool::start() -> bool
+{
+	// No reallocation, the threads refer to their Worker.
+	workers.reserve(num_threads - 1);
+	try {
+		for (size_t i = 1; i != num_threads; ++i) {
+			auto& w = workers.emplace_back();
+			w.thread = thread(&Ngram_Thread_Pool::work, this,
+			                  ref(w), i, generation);
+		}
+	}
+	catch (const system_error&) {
+		stop();
+		return false;
+	}
+	return true;
+}
+
+/**
+ * @internal
+ * @brief Stops and joins the threads.
+ */
+auto Ngram_Thread_Pool::stop() -> void
+{
+	{
+		auto lock = lock_guard<mutex>(mtx);
+		quit = true;
+	}
+	start_cv.notify_all();
+	for (auto& w : workers)
+		if (w.thread.joinable())
+			w.thread.join();
+	workers.clear();
+	quit = false;
+}
+
+auto Ngram_Thread_Pool::run_task(size_t n, Task t, void* data,
+                                 std::u32string& buf1, std::u32string& buf2,
+                                 Roots& roots) -> std::unique_lock<std::mutex>
+{
+	auto run_lock = unique_lock<mutex>(run_mtx, try_to_lock);
+	if (!run_lock)
+		return run_lock;
+	if (workers.empty() && !start()) {
+		run_lock.unlock();
+		return run_lock;
+	}
+	{
+		auto lock = lock_guard<mutex>(mtx);
+		task = t;
+		task_data = data;
+		num_parts = n;
+		pending = size(workers);
+		++generation;
+	}
+	start_cv.notify_all();
+	auto err = exception_ptr();
+	try {
+		t(data, 0, buf1, buf2, roots);
+	}
+	catch (...) {
+		err = current_exception();
+	}
+	// The other parts refer to the data, so wait for them in any case.
+	auto lock = unique_lock<mutex>(mtx);
+	done_cv.wait(lock, [&] { return pending == 0; });
+	if (!err)
+		err = error;
+	error = nullptr;
+	lock.unlock();
+	if (err)
+		rethrow_exception(err);
+	return run_lock;
+}
+
+/**
+ * @internal
+ * @brief Scores the candidates for ngram roots and adds them in order.
+ *
+ * The candidates 0 to @p n - 1 are scored with @p score_at, which returns a
+ * null word entry for a candidate that is not a root. When there are enough
+ * candidates, the range is split among the threads of @p pool. Each part
+ * keeps its roots in order, and the parts are passed to @p add_root one after
+ * another, so the roots are added in the order of the candidates in either
+ * case and the chosen roots, including ties, do not depend on the number of
+ * threads. If the pool is busy with another call, the calling thread scores
+ * them alone.
+ *
+ * The work is charged to the current Suggest_Budget in chunks and the scan
+ * stops early when it is exhausted.
+ */
+template <class Score_At, class Add_Root>
+auto static scan_ngram_roots(Ngram_Thread_Pool& pool, size_t n,
+                             Score_At& score_at, Add_Root& add_root) -> void
+{
+	constexpr auto min_candidates_per_thread = size_t(4096);
+	constexpr auto chunk_size = size_t(1024);
+	auto num_threads =
+	    min(pool.get_num_threads(), n / min_candidates_per_thread);
+	auto buf1 = Scratch<u32string>();
+	auto buf2 = Scratch<u32string>();
+	if (num_threads > 1) {
+		auto roots_buf = Scratch<vector<Word_Entry_And_Score>>();
+		auto stop = atomic<bool>(false);
+		auto score_part = [&](size_t part, u32string& b1, u32string& b2,
+		                      vector<Word_Entry_And_Score>& roots) {
+			roots.clear();
+			auto last = n * (part + 1) / num_threads;
+			for (auto i = n * part / num_threads;
+			     i != last && !stop;) {
+				auto chunk_last = min(i + chunk_size, last);
+				// The budget is kept per thread, so the
+				// calling thread charges the work of all.
+				if (part == 0 &&
+				    suggest_budget_exhausted(
+				        (chunk_last - i) * num_threads)) {
+					stop = true;
+					break;
+				}
+				for (; i != chunk_last; ++i) {
+					auto r = score_at(i, b1, b2);
+					if (r.word_entry)
+						roots.push_back(r);
+				}
+			}
+		};
+		auto lock = pool.run(num_threads, score_part, *buf1, *buf2,
+		                     *roots_buf);
+		if (lock) {
+			for (auto& r : *roots_buf)
+				add_root(r.word_entry, r.score);
+			for (size_t part = 1; part != num_threads; ++part)
+				for (auto& r : pool.part_roots(part))
+					add_root(r.word_entry, r.score);
+			return;
+		}
+	}
+	for (size_t i = 0; i != n;) {
+		auto chunk_last = min(i + chunk_size, n);
+		if (suggest_budget_exhausted(chunk_last - i))
+			return;
+		for (; i != chunk_last; ++i) {
+			auto r = score_at(i, *buf1, *buf2);
+			if (r.word_entry)
+				add_root(r.word_entry, r.score);
+		}
+	}
+}
+
+auto Suggester::ngram_suggest(const std::string& word_u8,
+                              List_Strings& out) const -> void
+{
+	auto wrong_word_buf = Scratch<u32string>();
+	auto wide_buf_buf = Scratch<u32string>();
+	auto roots_buf = Scratch<vector<Word_Entry_And_Score>>();
+	auto& wrong_word = *wrong_word_buf;
+	auto& wide_buf = *wide_buf_buf;
+	auto& roots = *roots_buf;
+	valid_utf8_to_32(word_u8, wrong_word);
+	auto add_root = [&](Word_List::const_pointer word_entry,
+	                    ptrdiff_t score) {
+		if (roots.size() != 100) {
+			roots.push_back({word_entry, score});
+			push_heap(begin(roots), end(roots));
+		}
+		else if (score > roots.front().score) {
+			pop_heap(begin(roots), end(roots));
+			roots.back() = {word_entry, score};
+			push_heap(begin(roots), end(roots));
+		}
+	};
+	auto image = ngram_image.get(
+	    [&](Ngram_Image& img) { build_ngram_image(img); });
+
+	// With the index only the roots that share a trigram with the wrong
+	// word are scored. Others may have scored higher, through common
+	// letters and bigrams, than the worst of the 100 roots that are kept.
+	// It is used only when there are enough candidates to fill them, and
+	// not so many that the scan of all entries costs about the same.
+	auto candidates_buf = Scratch<vector<size_t>>();
+	auto& candidates = *candidates_buf;
+	if (image && image->has_index())
+		image->find_candidates(wrong_word, candidates,
+		                       size(image->entries) / 4);
+	auto score_image_entry = [&](const Ngram_Image::Entry& e) {
+		auto score =
+		    left_common_substring_length(wrong_word, image->word(e));
+		score += ngram_similarity_longer_worse(3, wrong_word,
+		                                       image->lower(e));
+		return Word_Entry_And_Score{e.word_entry, score};
+	};
+	auto scan = [&](size_t n, auto&& score_at) {
+		scan_ngram_roots(ngram_threads, n, score_at, add_root);
+	};
+	if (size(candidates) >= 100) {
+		scan(size(candidates), [&](size_t i, u32string&, u32string&) {
+			return score_image_entry(image->entries[candidates[i]]);
+		});
+	}
+	else if (image) {
+		scan(size(image->entries),
+		     [&](size_t i, u32string&, u32string&) {
+			     return score_image_entry(image->entries[i]);
+		     });
+	}
+	else {
+		// Each bucket of the word list holds at most one word.
+		scan(words.bucket_count(), [&](size_t i, u32string& dict_word,
+		                               u32string& lower_dict_word) {
+			auto ret = Word_Entry_And_Score{nullptr, 0};
+			for (auto& word_entry : words.bucket_data(i)) {
+				if (!is_ngram_root(word_entry))
+					continue;
+				valid_utf8_to_32(word_entry.first, dict_word);
+				ret.word_entry = &word_entry;
+				ret.score = left_common_substring_length(
+				    wrong_word, dict_word);
+				to_lower(dict_word, icu_locale,
+				         lower_dict_word);
+				ret.score += ngram_similarity_longer_worse(
+				    3, wrong_word, lower_dict_word);
+			}
+			return ret;
+		});
+	}
+	if (suggest_budget_exhausted(0))
+		return;
 
 	auto threshold = ptrdiff_t();
 	for (auto k : {1u, 2u, 3u}) {
@@ -939,13 +1518,19 @@ auto Suggester::ngram_suggest(const std::string& word_u8,
 	}
 	threshold /= 3;
 
-	auto expanded_list = List_Strings();
-	auto expanded_cross_afx = vector<bool>();
-	auto expanded_word = u32string();
-	auto guess_words = vector<Word_And_Score>();
+	auto expanded_list_buf = Scratch<List_Strings>();
+	auto expanded_cross_afx_buf = Scratch<vector<bool>>();
+	auto expanded_word_buf = Scratch<u32string>();
+	auto guess_words_buf = Scratch<vector<Word_And_Score>>();
+	auto& expanded_list = *expanded_list_buf;
+	auto& expanded_cross_afx = *expanded_cross_afx_buf;
+	auto& expanded_word = *expanded_word_buf;
+	auto& guess_words = *guess_words_buf;
 	for (auto& root : roots) {
 		expand_root_word_for_ngram(*root.word_entry, word_u8,
 		                           expanded_list, expanded_cross_afx);
+		if (suggest_budget_exhausted(size(expanded_list)))
+			break;
 		for (auto& expanded_word_u8 : expanded_list) {
 			valid_utf8_to_32(expanded_word_u8, expanded_word);
 			auto score = left_common_substring_length(
@@ -965,15 +1550,18 @@ auto Suggester::ngram_suggest(const std::string& word_u8,
 			}
 			else if (score > guess_words.front().score) {
 				pop_heap(begin(guess_words), end(guess_words));
-				guess_words.back() = {move(expanded_word),
-				                      score};
+				// swap so that the buffer of the evicted word
+				// is reused
+				swap(guess_words.back().word, expanded_word);
+				guess_words.back().score = score;
 				push_heap(begin(guess_words), end(guess_words));
 			}
 		}
 	}
 	sort_heap(begin(guess_words), end(guess_words)); // is this needed?
 
-	auto lcs_state = vector<size_t>();
+	auto lcs_state_buf = Scratch<vector<size_t>>();
+	auto& lcs_state = *lcs_state_buf;
 	for (auto& [guess_word, score] : guess_words) {
 		auto& lower_guess_word = wide_buf;
 		to_lower(guess_word, icu_locale, lower_guess_word);
@@ -1046,9 +1634,10 @@ auto Suggester::expand_root_word_for_ngram(
 {
 	expanded_list.clear();
 	cross_affix.clear();
-	auto& [root, flags] = root_entry;
-	if (!flags.contains(need_affix_flag)) {
-		expanded_list.push_back(root);
+	auto& root = root_entry.first;
+	auto& flags = *root_entry.second;
+	if (!(flags.roles & ROLE_NEEDAFFIX)) {
+		expanded_list.emplace_back(root);
 		cross_affix.push_back(false);
 	}
 	if (flags.empty())
@@ -1072,7 +1661,7 @@ auto Suggester::expand_root_word_for_ngram(
 		    !ends_with(wrong, suffix.appending))
 			continue;
 
-		auto expanded = suffix.to_derived_copy(root);
+		auto expanded = suffix.to_derived_copy(string(root));
 		expanded_list.push_back(move(expanded));
 		cross_affix.push_back(suffix.cross_product);
 	}
@@ -1119,9 +1708,9 @@ auto Suggester::expand_root_word_for_ngram(
 		    !begins_with(wrong, prefix.appending))
 			continue;
 
-		auto expanded = prefix.to_derived_copy(root);
+		auto expanded = prefix.to_derived_copy(string(root));
 		expanded_list.push_back(move(expanded));
 	}
 }
-} // namespace v5
+} // namespace v6
 } // namespace nuspell
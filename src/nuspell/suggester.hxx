@@ -21,10 +21,259 @@
 
 #include "checker.hxx"
 
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+
 namespace nuspell {
-inline namespace v5 {
+inline namespace v6 {
+
+struct Suggest_Budget; // public, defined in dictionary.hxx
+
+auto current_suggest_budget() -> Suggest_Budget*;
+
+/**
+ * @internal
+ * @brief Makes a Suggest_Budget the current one of the thread for its
+ * lifetime.
+ */
+class Suggest_Budget_Scope {
+	Suggest_Budget* old;
+
+      public:
+	explicit Suggest_Budget_Scope(Suggest_Budget& budget);
+	~Suggest_Budget_Scope();
+	Suggest_Budget_Scope(const Suggest_Budget_Scope&) = delete;
+	auto operator=(const Suggest_Budget_Scope&)
+	    -> Suggest_Budget_Scope& = delete;
+};
+
+/**
+ * @internal
+ * @brief Lowercase UTF-32 copy of the roots scanned by ngram_suggest().
+ *
+ * Roots that are never suggested are left out. The entries are in the order
+ * of the word list, so scanning them gives the same results as scanning the
+ * word list. Roots that are already lowercase are stored once.
+ *
+ * Optionally it has an inverted index from the trigrams of the lowercase
+ * roots to the entries that contain them.
+ */
+struct NUSPELL_EXPORT Ngram_Image {
+	struct Entry {
+		Word_List::const_pointer word_entry;
+		uint32_t word_begin;
+		uint32_t word_size;
+		uint32_t lower_begin;
+		uint32_t lower_size;
+	};
+	std::u32string chars;
+	std::vector<Entry> entries;
+	std::vector<uint64_t> trigrams;        // sorted
+	std::vector<uint32_t> trigram_offsets; // into postings, one extra
+	std::vector<uint32_t> postings;        // indexes of entries
+
+	auto word(const Entry& e) const -> std::u32string_view
+	{
+		return std::u32string_view(chars).substr(e.word_begin,
+		                                         e.word_size);
+	}
+	auto lower(const Entry& e) const -> std::u32string_view
+	{
+		return std::u32string_view(chars).substr(e.lower_begin,
+		                                         e.lower_size);
+	}
+	auto build_index() -> void;
+	auto has_index() const -> bool { return !trigram_offsets.empty(); }
+	auto find_candidates(std::u32string_view word, std::vector<size_t>& out,
+	                     size_t max_size) const -> bool;
+};
+
+/**
+ * @internal
+ * @brief Ngram_Image that is built on first use, if enabled.
+ *
+ * Building is thread-safe. The image points into the word list of its owner,
+ * so copies only keep the setting and build their own image.
+ */
+class Lazy_Ngram_Image {
+	std::unique_ptr<Ngram_Image> image;
+	std::atomic<const Ngram_Image*> ready = nullptr;
+	std::mutex mtx;
+	bool enabled = false;
+	bool indexed = false;
+
+      public:
+	Lazy_Ngram_Image() = default;
+	Lazy_Ngram_Image(const Lazy_Ngram_Image& other)
+	    : enabled(other.enabled), indexed(other.indexed)
+	{
+	}
+	auto operator=(const Lazy_Ngram_Image& other) -> Lazy_Ngram_Image&
+	{
+		reset();
+		enabled = other.enabled;
+		indexed = other.indexed;
+		return *this;
+	}
+	auto set_enabled(bool e) -> void
+	{
+		enabled = e;
+		if (!e)
+			reset();
+	}
+	auto set_indexed(bool i) -> void
+	{
+		if (indexed != i)
+			reset();
+		indexed = i;
+	}
+	auto is_enabled() const -> bool { return enabled; }
+	auto is_indexed() const -> bool { return enabled && indexed; }
+
+	/**
+	 * @brief Drops the image, must be called when the word list changes.
+	 */
+	auto reset() -> void
+	{
+		ready = nullptr;
+		image.reset();
+	}
+
+	/**
+	 * @brief Gets the image, building it with @p build if needed.
+	 * @return the image or nullptr if disabled
+	 */
+	template <class Builder>
+	auto get(Builder&& build) -> const Ngram_Image*
+	{
+		if (!enabled)
+			return nullptr;
+		auto p = ready.load(std::memory_order_acquire);
+		if (p)
+			return p;
+		auto lock = std::lock_guard<std::mutex>(mtx);
+		if (!image) {
+			auto new_image = std::make_unique<Ngram_Image>();
+			build(*new_image);
+			if (indexed)
+				new_image->build_index();
+			image = std::move(new_image);
+		}
+		ready.store(image.get(), std::memory_order_release);
+		return image.get();
+	}
+};
+
+/**
+ * @internal
+ * @brief Threads that help scoring the ngram roots, started on first use.
+ *
+ * The threads and their buffers are kept until the number of threads changes
+ * or the owner is destroyed, so after warm-up no threads are started and no
+ * buffers are allocated. Only one call of run() uses the threads at a time.
+ * Copies only keep the number of threads and start their own.
+ */
+class NUSPELL_EXPORT Ngram_Thread_Pool {
+	using Roots = std::vector<Word_Entry_And_Score>;
+	using Task = void (*)(void* data, size_t part, std::u32string& buf1,
+	                      std::u32string& buf2, Roots& roots);
+	struct Worker {
+		std::thread thread;
+		std::u32string buf1;
+		std::u32string buf2;
+		Roots roots;
+	};
+	std::vector<Worker> workers;
+	size_t num_threads = 1;
+	std::mutex run_mtx;
+	std::mutex mtx; // guards the members below
+	std::condition_variable start_cv;
+	std::condition_variable done_cv;
+	Task task = nullptr;
+	void* task_data = nullptr;
+	size_t num_parts = 0;
+	size_t generation = 0;
+	size_t pending = 0;
+	std::exception_ptr error;
+	bool quit = false;
+
+	auto work(Worker& w, size_t part, size_t seen) -> void;
+	auto start() -> bool;
+	auto stop() -> void;
+	auto run_task(size_t n, Task t, void* data, std::u32string& buf1,
+	              std::u32string& buf2, Roots& roots)
+	    -> std::unique_lock<std::mutex>;
+
+      public:
+	Ngram_Thread_Pool() = default;
+	Ngram_Thread_Pool(const Ngram_Thread_Pool& other)
+	    : num_threads(other.num_threads)
+	{
+	}
+	auto operator=(const Ngram_Thread_Pool& other) -> Ngram_Thread_Pool&
+	{
+		set_num_threads(other.num_threads);
+		return *this;
+	}
+	~Ngram_Thread_Pool();
+	auto set_num_threads(size_t n) -> void;
+	auto get_num_threads() const -> size_t { return num_threads; }
+
+	/**
+	 * @brief Calls f(part, buf1, buf2, roots) for the parts 0 to @p n - 1.
+	 *
+	 * Part 0 is done by the calling thread with @p buf1, @p buf2 and
+	 * @p roots, the others by the threads of the pool with their own
+	 * buffers. The roots of the other parts can be read with part_roots()
+	 * as long as the returned lock is held.
+	 *
+	 * @param n number of parts, at most get_num_threads()
+	 * @return lock that keeps the other threads idle, or an empty lock if
+	 * the threads are busy with another call or can not be started, then
+	 * @p f is not called
+	 */
+	template <class F>
+	auto run(size_t n, F& f, std::u32string& buf1, std::u32string& buf2,
+	         Roots& roots) -> std::unique_lock<std::mutex>
+	{
+		auto t = [](void* data, size_t part, std::u32string& b1,
+		            std::u32string& b2, Roots& r) {
+			(*static_cast<F*>(data))(part, b1, b2, r);
+		};
+		return run_task(n, t, &f, buf1, buf2, roots);
+	}
+	/**
+	 * @brief Gets the roots of a part done by the threads of the pool.
+	 * @param part part number from 1 to n - 1 of the last call of run()
+	 */
+	auto part_roots(size_t part) const -> const Roots&
+	{
+		return workers[part - 1].roots;
+	}
+};
+
+NUSPELL_EXPORT auto ngram_similarity_by_find(size_t n, std::u32string_view a,
+                                             std::u32string_view b)
+    -> ptrdiff_t;
+NUSPELL_EXPORT auto ngram_similarity_weighted_by_find(size_t n,
+                                                      std::u32string_view a,
+                                                      std::u32string_view b)
+    -> ptrdiff_t;
+NUSPELL_EXPORT auto ngram_similarity_low_level(size_t n, std::u32string_view a,
+                                               std::u32string_view b)
+    -> ptrdiff_t;
+NUSPELL_EXPORT auto ngram_similarity_weighted_low_level(
+    size_t n, std::u32string_view a, std::u32string_view b) -> ptrdiff_t;
+NUSPELL_EXPORT auto longest_common_subsequence_length(
+    std::u32string_view a, std::u32string_view b,
+    std::vector<size_t>& state_buffer) -> ptrdiff_t;
 
 struct NUSPELL_EXPORT Suggester : public Checker {
+	mutable Lazy_Ngram_Image ngram_image;
+	mutable Ngram_Thread_Pool ngram_threads;
 
 	enum High_Quality_Sugs : bool {
 		ALL_LOW_QUALITY_SUGS = false,
@@ -82,6 +331,8 @@ struct NUSPELL_EXPORT Suggester : public Checker {
 	auto two_words_suggest(const std::string& word, List_Strings& out) const
 	    -> void;
 
+	auto build_ngram_image(Ngram_Image& image) const -> void;
+
 	auto ngram_suggest(const std::string& word_u8, List_Strings& out) const
 	    -> void;
 
@@ -92,6 +343,6 @@ struct NUSPELL_EXPORT Suggester : public Checker {
 	    -> void;
 };
 
-} // namespace v5
+} // namespace v6
 } // namespace nuspell
 #endif // NUSPELL_SUGGESTER_HXX
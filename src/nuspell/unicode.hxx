@@ -23,7 +23,7 @@
 #include <unicode/utf8.h>
 
 namespace nuspell {
-inline namespace v5 {
+inline namespace v6 {
 
 // UTF-8, work on malformed
 
@@ -378,6 +378,6 @@ template <class Range>
 	valid_u8_write_cp_and_advance(buf, i, cp);
 	return i;
 }
-} // namespace v5
+} // namespace v6
 } // namespace nuspell
 #endif // NUSPELL_UNICODE_HXX
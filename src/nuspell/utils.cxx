@@ -20,13 +20,32 @@
 #include "unicode.hxx"
 
 #include <algorithm>
+#include <cstring>
+#include <fstream>
 #include <limits>
+#include <sstream>
 
 #include <unicode/uchar.h>
+#include <unicode/ucasemap.h>
 #include <unicode/ucnv.h>
 #include <unicode/unistr.h>
 #include <unicode/ustring.h>
 
+#ifdef _POSIX_VERSION
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define NUSPELL_HAVE_AVX2_DISPATCH 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || _M_IX86_FP >= 2
+#include <emmintrin.h>
+#define NUSPELL_HAVE_SSE2 1
+#endif
+
 #if ' ' != 32 || '.' != 46 || 'A' != 65 || 'Z' != 90 || 'a' != 97 || 'z' != 122
 #error "Basic execution character set is not ASCII"
 #endif
@@ -34,7 +53,7 @@
 using namespace std;
 
 namespace nuspell {
-inline namespace v5 {
+inline namespace v6 {
 
 template <class SepT>
 static auto& split_on_any_of_low(std::string_view s, const SepT& sep,
@@ -87,14 +106,48 @@ auto split_on_any_of(std::string_view s, const char* sep,
 	return split_on_any_of_low(s, sep, out);
 }
 
+/**
+ * @internal
+ * @brief Narrows a run of ASCII code points in UTF-32 to UTF-8.
+ * @return number of code points converted, stops at the first non-ASCII block
+ */
+auto static narrow_ascii(const char32_t* in, size_t n, char* out) -> size_t
+{
+	auto i = size_t(0);
+#if NUSPELL_HAVE_SSE2
+	auto const non_ascii = _mm_set1_epi32(~0x7F);
+	for (; n - i >= 8; i += 8) {
+		auto p = reinterpret_cast<const __m128i*>(in + i);
+		auto a = _mm_loadu_si128(p);
+		auto b = _mm_loadu_si128(p + 1);
+		auto high = _mm_and_si128(_mm_or_si128(a, b), non_ascii);
+		auto is_ascii = _mm_cmpeq_epi32(high, _mm_setzero_si128());
+		if (_mm_movemask_epi8(is_ascii) != 0xFFFF)
+			break;
+		auto bytes = _mm_packus_epi16(_mm_packs_epi32(a, b),
+		                              _mm_setzero_si128());
+		_mm_storel_epi64(reinterpret_cast<__m128i*>(out + i), bytes);
+	}
+#endif
+	for (; i != n && in[i] < 0x80; ++i)
+		out[i] = char(in[i]);
+	return i;
+}
+
 auto utf32_to_utf8(std::u32string_view in, std::string& out) -> void
 {
-	out.clear();
-	for (size_t i = 0; i != size(in); ++i) {
-		auto cp = in[i];
-		auto enc_cp = U8_Encoded_CP(cp);
-		out += enc_cp;
+	out.resize(size(in) * 4);
+	auto o = size_t(0);
+	for (size_t i = 0; i != size(in);) {
+		auto n = narrow_ascii(&in[i], size(in) - i, &out[o]);
+		i += n;
+		o += n;
+		if (i == size(in))
+			break;
+		valid_u8_write_cp_and_advance(out, o, in[i]);
+		++i;
 	}
+	out.resize(o);
 }
 auto utf32_to_utf8(std::u32string_view in) -> std::string
 {
@@ -103,14 +156,49 @@ auto utf32_to_utf8(std::u32string_view in) -> std::string
 	return out;
 }
 
+/**
+ * @internal
+ * @brief Widens a run of ASCII in UTF-8 to UTF-32.
+ * @return number of bytes converted, stops at the first non-ASCII byte
+ */
+auto static widen_ascii(const char* in, size_t n, char32_t* out) -> size_t
+{
+	auto i = size_t(0);
+#if NUSPELL_HAVE_SSE2
+	auto const zero = _mm_setzero_si128();
+	for (; n - i >= 16; i += 16) {
+		auto v = _mm_loadu_si128(
+		    reinterpret_cast<const __m128i*>(in + i));
+		if (_mm_movemask_epi8(v) != 0)
+			break;
+		auto lo = _mm_unpacklo_epi8(v, zero);
+		auto hi = _mm_unpackhi_epi8(v, zero);
+		auto p = reinterpret_cast<__m128i*>(out + i);
+		_mm_storeu_si128(p, _mm_unpacklo_epi16(lo, zero));
+		_mm_storeu_si128(p + 1, _mm_unpackhi_epi16(lo, zero));
+		_mm_storeu_si128(p + 2, _mm_unpacklo_epi16(hi, zero));
+		_mm_storeu_si128(p + 3, _mm_unpackhi_epi16(hi, zero));
+	}
+#endif
+	for (; i != n && static_cast<unsigned char>(in[i]) < 0x80; ++i)
+		out[i] = in[i];
+	return i;
+}
+
 auto valid_utf8_to_32(std::string_view in, std::u32string& out) -> void
 {
-	out.clear();
+	out.resize(size(in));
+	auto o = size_t(0);
 	for (size_t i = 0; i != size(in);) {
-		char32_t cp;
-		valid_u8_advance_cp(in, i, cp);
-		out.push_back(cp);
+		auto n = widen_ascii(&in[i], size(in) - i, &out[o]);
+		i += n;
+		o += n;
+		if (i == size(in))
+			break;
+		valid_u8_advance_cp(in, i, out[o]);
+		++o;
 	}
+	out.resize(o);
 }
 auto valid_utf8_to_32(std::string_view in) -> std::u32string
 {
@@ -143,23 +231,298 @@ bool utf8_to_16(std::string_view in, std::u16string& out)
 	return false;
 }
 
-bool validate_utf8(string_view s)
+/**
+ * @internal
+ * @brief Gets the length of the ASCII prefix of a string.
+ *
+ * Checks 16 or 8 bytes at once, the result is not exact, it may stop up to
+ * that many bytes before the first non-ASCII byte.
+ */
+auto static ascii_prefix_length(const unsigned char* s, size_t n) -> size_t
+{
+	auto i = size_t(0);
+#if NUSPELL_HAVE_SSE2
+	for (; n - i >= 16; i += 16) {
+		auto p = reinterpret_cast<const __m128i*>(s + i);
+		auto v = _mm_loadu_si128(p);
+		if (_mm_movemask_epi8(v) != 0)
+			break;
+	}
+#else
+	for (; n - i >= 8; i += 8) {
+		uint64_t v;
+		memcpy(&v, s + i, 8);
+		if ((v & 0x8080808080808080) != 0)
+			break;
+	}
+#endif
+	return i;
+}
+
+/**
+ * @internal
+ * @brief Validates UTF-8 one code point at a time.
+ *
+ * Rejects overlong forms, surrogates and code points above U+10FFFF, per
+ * table 3-7 of the Unicode standard. Runs of ASCII are skipped in blocks.
+ */
+auto static validate_utf8_scalar(const unsigned char* s, size_t n) -> bool
 {
-	auto err = U_ZERO_ERROR;
-	u_strFromUTF8(nullptr, 0, nullptr, data(s), size(s), &err);
-	if (err == U_INVALID_CHAR_FOUND)
-		return false;
-	return err == U_BUFFER_OVERFLOW_ERROR || U_SUCCESS(err);
+	for (size_t i = 0; i != n;) {
+		if (s[i] < 0x80) {
+			i += ascii_prefix_length(s + i, n - i);
+			for (; i != n && s[i] < 0x80; ++i) {
+			}
+			continue;
+		}
+		auto c = s[i];
+		auto len = size_t();
+		auto lo = (unsigned char)0x80, hi = (unsigned char)0xBF;
+		if (0xC2 <= c && c <= 0xDF) {
+			len = 2;
+		}
+		else if (0xE0 <= c && c <= 0xEF) {
+			len = 3;
+			if (c == 0xE0)
+				lo = 0xA0;
+			else if (c == 0xED)
+				hi = 0x9F;
+		}
+		else if (0xF0 <= c && c <= 0xF4) {
+			len = 4;
+			if (c == 0xF0)
+				lo = 0x90;
+			else if (c == 0xF4)
+				hi = 0x8F;
+		}
+		else {
+			return false;
+		}
+		if (n - i < len)
+			return false;
+		if (s[i + 1] < lo || s[i + 1] > hi)
+			return false;
+		for (size_t j = 2; j != len; ++j)
+			if ((s[i + j] & 0xC0) != 0x80)
+				return false;
+		i += len;
+	}
+	return true;
+}
+
+auto static is_all_ascii_scalar(const unsigned char* s, size_t n) -> bool
+{
+	auto i = ascii_prefix_length(s, n);
+	return all_of(s + i, s + n, [](unsigned char c) { return c < 0x80; });
+}
+
+#if NUSPELL_HAVE_AVX2_DISPATCH
+#define NUSPELL_AVX2 __attribute__((target("avx2")))
+namespace {
+/**
+ * @internal
+ * @brief UTF-8 validator with AVX2, processes 32 bytes at once.
+ *
+ * This is the lookup algorithm from J. Keiser, D. Lemire, "Validating UTF-8
+ * In Less Than One Instruction Per Byte". Three table lookups on the nibbles
+ * of each byte and its predecessor classify all errors within two bytes, the
+ * remaining checks are for the continuation bytes of 3 and 4 byte sequences.
+ */
+struct Utf8_Checker_Avx2 {
+	// Error classes, a byte pair is invalid if a bit is set in all three
+	// lookups.
+	static constexpr char TOO_SHORT = 1 << 0;
+	static constexpr char TOO_LONG = 1 << 1;
+	static constexpr char OVERLONG_3 = 1 << 2;
+	static constexpr char TOO_LARGE = 1 << 3;
+	static constexpr char SURROGATE = 1 << 4;
+	static constexpr char OVERLONG_2 = 1 << 5;
+	static constexpr char TOO_LARGE_1000 = 1 << 6;
+	static constexpr char OVERLONG_4 = 1 << 6;
+	static constexpr char TWO_CONTS = char(1 << 7);
+	static constexpr char CARRY = TOO_SHORT | TOO_LONG | TWO_CONTS;
+
+	__m256i error;
+	__m256i prev_input;
+	__m256i prev_incomplete;
+
+	NUSPELL_AVX2 auto static prev(__m256i in, __m256i prev_in, int n)
+	    -> __m256i
+	{
+		auto t = _mm256_permute2x128_si256(prev_in, in, 0x21);
+		switch (n) {
+		case 1:
+			return _mm256_alignr_epi8(in, t, 15);
+		case 2:
+			return _mm256_alignr_epi8(in, t, 14);
+		default:
+			return _mm256_alignr_epi8(in, t, 13);
+		}
+	}
+
+	NUSPELL_AVX2 auto static high_nibbles(__m256i v) -> __m256i
+	{
+		return _mm256_and_si256(_mm256_srli_epi16(v, 4),
+		                        _mm256_set1_epi8(0x0F));
+	}
+
+	NUSPELL_AVX2 auto static special_cases(__m256i in, __m256i prev1)
+	    -> __m256i
+	{
+		auto const byte_1_high_table = _mm256_setr_epi8(
+		    TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+		    TOO_LONG, TOO_LONG, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+		    TWO_CONTS, TOO_SHORT | OVERLONG_2, TOO_SHORT,
+		    TOO_SHORT | OVERLONG_3 | SURROGATE,
+		    TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4,
+		    TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG, TOO_LONG,
+		    TOO_LONG, TOO_LONG, TWO_CONTS, TWO_CONTS, TWO_CONTS,
+		    TWO_CONTS, TOO_SHORT | OVERLONG_2, TOO_SHORT,
+		    TOO_SHORT | OVERLONG_3 | SURROGATE,
+		    TOO_SHORT | TOO_LARGE | TOO_LARGE_1000 | OVERLONG_4);
+		constexpr char L = CARRY | TOO_LARGE | TOO_LARGE_1000;
+		auto const byte_1_low_table = _mm256_setr_epi8(
+		    CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+		    CARRY | OVERLONG_2, CARRY, CARRY, CARRY | TOO_LARGE, L, L,
+		    L, L, L, L, L, L, L | SURROGATE, L, L,
+		    CARRY | OVERLONG_3 | OVERLONG_2 | OVERLONG_4,
+		    CARRY | OVERLONG_2, CARRY, CARRY, CARRY | TOO_LARGE, L, L,
+		    L, L, L, L, L, L, L | SURROGATE, L, L);
+		constexpr char C1000 = TOO_LONG | OVERLONG_2 | TWO_CONTS |
+		                       OVERLONG_3 | TOO_LARGE_1000 |
+		                       OVERLONG_4;
+		constexpr char C1001 = TOO_LONG | OVERLONG_2 | TWO_CONTS |
+		                       OVERLONG_3 | TOO_LARGE;
+		constexpr char C101 = TOO_LONG | OVERLONG_2 | TWO_CONTS |
+		                      SURROGATE | TOO_LARGE;
+		constexpr char S = TOO_SHORT;
+		auto const byte_2_high_table = _mm256_setr_epi8(
+		    S, S, S, S, S, S, S, S, C1000, C1001, C101, C101, S, S, S,
+		    S, S, S, S, S, S, S, S, S, C1000, C1001, C101, C101, S, S,
+		    S, S);
+		auto byte_1_high = _mm256_shuffle_epi8(byte_1_high_table,
+		                                       high_nibbles(prev1));
+		auto byte_1_low = _mm256_shuffle_epi8(
+		    byte_1_low_table,
+		    _mm256_and_si256(prev1, _mm256_set1_epi8(0x0F)));
+		auto byte_2_high =
+		    _mm256_shuffle_epi8(byte_2_high_table, high_nibbles(in));
+		auto sc = _mm256_and_si256(byte_1_high, byte_1_low);
+		return _mm256_and_si256(sc, byte_2_high);
+	}
+
+	NUSPELL_AVX2 auto check_block(__m256i in) -> void
+	{
+		if (_mm256_movemask_epi8(in) == 0) {
+			// An ASCII block only needs the previous one complete.
+			error = _mm256_or_si256(error, prev_incomplete);
+			return;
+		}
+		auto prev1 = prev(in, prev_input, 1);
+		auto sc = special_cases(in, prev1);
+		auto prev2 = prev(in, prev_input, 2);
+		auto prev3 = prev(in, prev_input, 3);
+		// the high bit is set where a third or fourth byte is expected
+		auto is_third = _mm256_subs_epu8(prev2, _mm256_set1_epi8(0x60));
+		auto is_fourth =
+		    _mm256_subs_epu8(prev3, _mm256_set1_epi8(0x70));
+		auto must_23 = _mm256_and_si256(
+		    _mm256_or_si256(is_third, is_fourth),
+		    _mm256_set1_epi8(char(0x80)));
+		error = _mm256_or_si256(error, _mm256_xor_si256(must_23, sc));
+		// last three bytes of the block must not start a sequence
+		// longer than what fits
+		auto const max = _mm256_setr_epi8(
+		    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+		    char(0xF0 - 1), char(0xE0 - 1), char(0xC0 - 1));
+		prev_incomplete = _mm256_subs_epu8(in, max);
+		prev_input = in;
+	}
+
+	NUSPELL_AVX2 auto validate(const unsigned char* s, size_t n) -> bool
+	{
+		error = _mm256_setzero_si256();
+		prev_input = _mm256_setzero_si256();
+		prev_incomplete = _mm256_setzero_si256();
+		auto i = size_t(0);
+		for (; n - i >= 32; i += 32) {
+			auto p = reinterpret_cast<const __m256i*>(s + i);
+			check_block(_mm256_loadu_si256(p));
+		}
+		if (i != n) {
+			alignas(32) unsigned char tail[32] = {};
+			memcpy(tail, s + i, n - i);
+			auto p = reinterpret_cast<const __m256i*>(tail);
+			check_block(_mm256_load_si256(p));
+		}
+		error = _mm256_or_si256(error, prev_incomplete);
+		return _mm256_testz_si256(error, error);
+	}
+};
+} // namespace
+
+NUSPELL_AVX2 auto static validate_utf8_avx2(const unsigned char* s, size_t n)
+    -> bool
+{
+	auto checker = Utf8_Checker_Avx2();
+	return checker.validate(s, n);
 }
 
-auto static is_ascii(char c) -> bool
+NUSPELL_AVX2 auto static is_all_ascii_avx2(const unsigned char* s, size_t n)
+    -> bool
+{
+	auto acc = _mm256_setzero_si256();
+	auto i = size_t(0);
+	for (; n - i >= 32; i += 32) {
+		auto p = reinterpret_cast<const __m256i*>(s + i);
+		acc = _mm256_or_si256(acc, _mm256_loadu_si256(p));
+	}
+	return _mm256_movemask_epi8(acc) == 0 &&
+	       is_all_ascii_scalar(s + i, n - i);
+}
+#undef NUSPELL_AVX2
+#endif
+
+namespace {
+/**
+ * @internal
+ * @brief The implementations of the string scans chosen for the CPU.
+ */
+struct Scan_Functions {
+	bool (*validate_utf8)(const unsigned char*, size_t) =
+	    validate_utf8_scalar;
+	bool (*is_all_ascii)(const unsigned char*, size_t) =
+	    is_all_ascii_scalar;
+
+	Scan_Functions()
+	{
+#if NUSPELL_HAVE_AVX2_DISPATCH
+		if (__builtin_cpu_supports("avx2")) {
+			validate_utf8 = validate_utf8_avx2;
+			is_all_ascii = is_all_ascii_avx2;
+		}
+#endif
+	}
+};
+} // namespace
+
+auto static get_scan_functions() -> const Scan_Functions&
+{
+	static const auto f = Scan_Functions();
+	return f;
+}
+
+auto validate_utf8(string_view s) -> bool
 {
-	return static_cast<unsigned char>(c) <= 127;
+	auto p = reinterpret_cast<const unsigned char*>(data(s));
+	return get_scan_functions().validate_utf8(p, size(s));
 }
 
 auto is_all_ascii(std::string_view s) -> bool
 {
-	return all_of(begin(s), end(s), is_ascii);
+	auto p = reinterpret_cast<const unsigned char*>(data(s));
+	return get_scan_functions().is_all_ascii(p, size(s));
 }
 
 auto static widen_latin1(char c) -> char16_t
@@ -215,6 +578,234 @@ auto static icu_to_utf32(const icu::UnicodeString& in, std::u32string& out)
 	return false;
 }
 
+namespace {
+enum class Case_Op { LOWER, UPPER, TITLE };
+}
+
+/**
+ * @internal
+ * @brief Checks if the locale has special case mapping for Latin letters.
+ *
+ * Turkish and Azeri map the dotted and dotless i differently and Lithuanian
+ * keeps the dot of i when it has an accent. Dutch titlecases the digraph ij.
+ */
+auto static has_special_latin_casing(const icu::Locale& loc, Case_Op op)
+    -> bool
+{
+	auto lang = string_view(loc.getLanguage());
+	if (lang == "tr" || lang == "az" || lang == "lt")
+		return true;
+	return op == Case_Op::TITLE && lang == "nl";
+}
+
+auto static is_latin1_letter(char32_t cp) -> bool
+{
+	if (cp < 0x80)
+		return ('A' <= cp && cp <= 'Z') || ('a' <= cp && cp <= 'z');
+	return cp == 0xAA || cp == 0xB5 || cp == 0xBA ||
+	       (cp >= 0xC0 && cp != 0xD7 && cp != 0xF7);
+}
+
+/**
+ * @internal
+ * @brief Checks if the upper or title case of a code point is a single code
+ * point in Latin-1.
+ *
+ * Does not hold for ß (to SS), ÿ (to U+0178) and µ (to Greek capital mu).
+ */
+auto static has_latin1_upper(char32_t cp) -> bool
+{
+	return cp < 0x100 && cp != 0xDF && cp != 0xFF && cp != 0xB5;
+}
+
+auto static latin1_to_lower(char32_t cp) -> char32_t
+{
+	if (('A' <= cp && cp <= 'Z') || (0xC0 <= cp && cp <= 0xDE && cp != 0xD7))
+		return cp + 0x20;
+	return cp;
+}
+
+auto static latin1_to_upper(char32_t cp) -> char32_t
+{
+	if (('a' <= cp && cp <= 'z') || (0xE0 <= cp && cp <= 0xFE && cp != 0xF7))
+		return cp - 0x20;
+	return cp;
+}
+
+/**
+ * @internal
+ * @brief Maps the case of ASCII and Latin-1 text without ICU.
+ *
+ * For these code points the mapping does not depend on the context and keeps
+ * the length of the UTF-8 encoding, so it is done in place byte by byte. Title
+ * case is only handled for a single word made of letters.
+ *
+ * @param in valid UTF-8 string, may be a part of @p out
+ * @param loc locale
+ * @param op operation
+ * @param out output, untouched if the function returns false
+ * @return false if ICU is needed
+ */
+auto static latin1_case_map(string_view in, const icu::Locale& loc,
+                            Case_Op op, string& out) -> bool
+{
+	if (has_special_latin_casing(loc, op))
+		return false;
+	for (size_t i = 0; i != size(in); ++i) {
+		auto c = static_cast<unsigned char>(in[i]);
+		auto cp = char32_t(c);
+		if (c >= 0x80) {
+			if ((c != 0xC2 && c != 0xC3) || i + 1 == size(in))
+				return false;
+			auto c2 = static_cast<unsigned char>(in[++i]);
+			cp = (cp & 0x1F) << 6 | (c2 & 0x3F);
+			if (op != Case_Op::LOWER && !has_latin1_upper(cp))
+				return false;
+		}
+		if (op == Case_Op::TITLE && !is_latin1_letter(cp))
+			return false;
+	}
+	out.assign(in);
+	for (size_t i = 0; i != size(out); ++i) {
+		auto c = static_cast<unsigned char>(out[i]);
+		auto up =
+		    op == Case_Op::UPPER || (op == Case_Op::TITLE && i == 0);
+		if (c < 0x80) {
+			auto cp = up ? latin1_to_upper(c) : latin1_to_lower(c);
+			out[i] = char(cp);
+			continue;
+		}
+		// The letters of Latin-1 Supplement all have lead byte C3.
+		++i;
+		if (c != 0xC3)
+			continue;
+		auto cp = char32_t(0xC0 | (out[i] & 0x3F));
+		cp = up ? latin1_to_upper(cp) : latin1_to_lower(cp);
+		out[i] = char(0x80 | (cp & 0x3F));
+	}
+	return true;
+}
+
+/**
+ * @internal
+ * @brief Maps the case of one code point in a UTF-8 string without ICU.
+ * @return false if ICU is needed
+ */
+auto static latin1_case_map_at(string& s, size_t i, const icu::Locale& loc,
+                               Case_Op op) -> bool
+{
+	auto cp = valid_u8_next_cp(s, i);
+	if (cp.cp >= 0x100 || has_special_latin_casing(loc, op))
+		return false;
+	if (op != Case_Op::LOWER && !has_latin1_upper(cp.cp))
+		return false;
+	auto c = op == Case_Op::LOWER ? latin1_to_lower(cp.cp)
+	                               : latin1_to_upper(cp.cp);
+	if (c < 0x80)
+		s[i] = char(c);
+	else
+		s[i + 1] = char(0x80 | (c & 0x3F));
+	return true;
+}
+
+namespace {
+struct UCaseMap_Deleter {
+	auto operator()(UCaseMap* p) const -> void { ucasemap_close(p); }
+};
+
+/**
+ * @internal
+ * @brief Per-thread cache of UCaseMap objects, one per locale.
+ *
+ * Opening a UCaseMap loads the locale data, so they are kept between calls.
+ * They can not be shared between threads because title casing changes the
+ * break iterator of the UCaseMap.
+ */
+class Case_Map_Cache {
+	struct Entry {
+		string locale;
+		unique_ptr<UCaseMap, UCaseMap_Deleter> case_map;
+	};
+	static constexpr size_t max_entries = 8;
+	vector<Entry> entries;
+
+      public:
+	auto get(const icu::Locale& loc) -> UCaseMap*
+	{
+		auto name = string_view(loc.getName());
+		for (auto& e : entries)
+			if (e.locale == name)
+				return e.case_map.get();
+		auto err = U_ZERO_ERROR;
+		auto case_map = ucasemap_open(data(name), 0, &err);
+		if (U_FAILURE(err))
+			return nullptr;
+		if (size(entries) == max_entries)
+			entries.erase(begin(entries));
+		entries.push_back({string(name), {case_map, {}}});
+		return case_map;
+	}
+};
+
+thread_local Case_Map_Cache case_maps;
+thread_local string case_map_u8_in;
+thread_local string case_map_u8_out;
+} // namespace
+
+/**
+ * @internal
+ * @brief Maps the case of UTF-8 text with ICU without converting to UTF-16.
+ *
+ * @param in valid UTF-8 string, may be a part of @p out
+ * @param loc locale
+ * @param op operation
+ * @param out output, untouched if the function returns false
+ * @return false on error, then the UnicodeString API should be used
+ */
+auto static utf8_case_map(string_view in, const icu::Locale& loc, Case_Op op,
+                          string& out) -> bool
+{
+	auto case_map = case_maps.get(loc);
+	if (!case_map)
+		return false;
+	auto map = [&](string& dst, UErrorCode& err) {
+		auto d = data(dst);
+		auto cap = int32_t(size(dst));
+		auto sz = int32_t(size(in));
+		switch (op) {
+		case Case_Op::LOWER:
+			return ucasemap_utf8ToLower(case_map, d, cap, data(in),
+			                            sz, &err);
+		case Case_Op::UPPER:
+			return ucasemap_utf8ToUpper(case_map, d, cap, data(in),
+			                            sz, &err);
+		case Case_Op::TITLE:
+			return ucasemap_utf8ToTitle(case_map, d, cap, data(in),
+			                            sz, &err);
+		}
+		return int32_t();
+	};
+	auto in_ptr = data(in);
+	auto aliases = data(out) <= in_ptr && in_ptr <= data(out) + size(out);
+	auto& dst = aliases ? case_map_u8_out : out;
+	dst.resize(max(dst.capacity(), size(in)));
+	auto err = U_ZERO_ERROR;
+	auto len = map(dst, err);
+	if (err == U_BUFFER_OVERFLOW_ERROR) {
+		dst.resize(len);
+		err = U_ZERO_ERROR;
+		len = map(dst, err);
+	}
+	if (U_FAILURE(err)) {
+		dst.clear();
+		return false;
+	}
+	dst.resize(len);
+	if (aliases)
+		out.swap(dst);
+	return true;
+}
+
 auto to_upper(std::string_view in, const icu::Locale& loc) -> std::string
 {
 	auto out = std::string();
@@ -236,6 +827,10 @@ auto to_lower(std::string_view in, const icu::Locale& loc) -> std::string
 
 auto to_upper(string_view in, const icu::Locale& loc, string& out) -> void
 {
+	if (latin1_case_map(in, loc, Case_Op::UPPER, out))
+		return;
+	if (utf8_case_map(in, loc, Case_Op::UPPER, out))
+		return;
 	auto sp = icu::StringPiece(data(in), size(in));
 	auto us = icu::UnicodeString::fromUTF8(sp);
 	us.toUpper(loc);
@@ -244,6 +839,10 @@ auto to_upper(string_view in, const icu::Locale& loc, string& out) -> void
 }
 auto to_title(string_view in, const icu::Locale& loc, string& out) -> void
 {
+	if (latin1_case_map(in, loc, Case_Op::TITLE, out))
+		return;
+	if (utf8_case_map(in, loc, Case_Op::TITLE, out))
+		return;
 	auto sp = icu::StringPiece(data(in), size(in));
 	auto us = icu::UnicodeString::fromUTF8(sp);
 	us.toTitle(nullptr, loc);
@@ -252,12 +851,31 @@ auto to_title(string_view in, const icu::Locale& loc, string& out) -> void
 }
 auto to_lower(u32string_view in, const icu::Locale& loc, u32string& out) -> void
 {
+	auto is_latin1 = [](char32_t c) { return c < 0x100; };
+	if (all_of(begin(in), end(in), is_latin1) &&
+	    !has_special_latin_casing(loc, Case_Op::LOWER)) {
+		out.assign(in);
+		transform(begin(out), end(out), begin(out), latin1_to_lower);
+		return;
+	}
+	// UCaseMap has no UTF-32 API, but the conversions to and from UTF-8
+	// into reused buffers are cheaper than the ones to UnicodeString.
+	utf32_to_utf8(in, case_map_u8_in);
+	if (utf8_case_map(case_map_u8_in, loc, Case_Op::LOWER,
+	                  case_map_u8_in)) {
+		valid_utf8_to_32(case_map_u8_in, out);
+		return;
+	}
 	auto us = utf32_to_icu(in);
 	us.toLower(loc);
 	icu_to_utf32(us, out);
 }
 auto to_lower(string_view in, const icu::Locale& loc, string& out) -> void
 {
+	if (latin1_case_map(in, loc, Case_Op::LOWER, out))
+		return;
+	if (utf8_case_map(in, loc, Case_Op::LOWER, out))
+		return;
 	auto sp = icu::StringPiece(data(in), size(in));
 	auto us = icu::UnicodeString::fromUTF8(sp);
 	us.toLower(loc);
@@ -267,7 +885,14 @@ auto to_lower(string_view in, const icu::Locale& loc, string& out) -> void
 
 auto to_lower_char_at(std::string& s, size_t i, const icu::Locale& loc) -> void
 {
+	if (latin1_case_map_at(s, i, loc, Case_Op::LOWER))
+		return;
 	auto cp = valid_u8_next_cp(s, i);
+	auto enc_cp = string_view(s).substr(i, cp.end_i - i);
+	if (utf8_case_map(enc_cp, loc, Case_Op::LOWER, case_map_u8_in)) {
+		s.replace(i, size(enc_cp), case_map_u8_in);
+		return;
+	}
 	auto us = icu::UnicodeString(UChar32(cp.cp));
 	us.toLower(loc);
 	auto u8_low = string();
@@ -276,7 +901,14 @@ auto to_lower_char_at(std::string& s, size_t i, const icu::Locale& loc) -> void
 }
 auto to_title_char_at(std::string& s, size_t i, const icu::Locale& loc) -> void
 {
+	if (latin1_case_map_at(s, i, loc, Case_Op::TITLE))
+		return;
 	auto cp = valid_u8_next_cp(s, i);
+	auto enc_cp = string_view(s).substr(i, cp.end_i - i);
+	if (utf8_case_map(enc_cp, loc, Case_Op::TITLE, case_map_u8_in)) {
+		s.replace(i, size(enc_cp), case_map_u8_in);
+		return;
+	}
 	auto us = icu::UnicodeString(UChar32(cp.cp));
 	us.toTitle(nullptr, loc);
 	auto u8_title = string();
@@ -297,6 +929,20 @@ auto classify_casing(string_view s) -> Casing
 {
 	size_t upper = 0;
 	size_t lower = 0;
+	if (is_all_ascii(s)) {
+		for (auto c : s) {
+			upper += 'A' <= c && c <= 'Z';
+			lower += 'a' <= c && c <= 'z';
+		}
+		if (upper == 0)
+			return Casing::SMALL;
+		auto first_capital = 'A' <= s[0] && s[0] <= 'Z';
+		if (first_capital && upper == 1)
+			return Casing::INIT_CAPITAL;
+		if (lower == 0)
+			return Casing::ALL_CAPITAL;
+		return first_capital ? Casing::PASCAL : Casing::CAMEL;
+	}
 	for (size_t i = 0; i != size(s);) {
 		char32_t c;
 		valid_u8_advance_cp(s, i, c);
@@ -396,6 +1042,61 @@ auto Encoding_Converter::to_utf8(string_view in, string& out) -> bool
 	return U_SUCCESS(err);
 }
 
+/**
+ * @internal
+ * @brief Opens a file and makes its content available via view().
+ * @param file_path path to the file
+ * @return true on success, false if the file can not be opened or read
+ */
+auto Mapped_File::open(const std::string& file_path) -> bool
+{
+	close();
+#ifdef _POSIX_VERSION
+	auto fd = ::open(file_path.c_str(), O_RDONLY);
+	if (fd == -1)
+		return false;
+	struct stat st;
+	if (fstat(fd, &st) == 0 && st.st_size > 0) {
+		auto p = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd,
+		              0);
+		if (p != MAP_FAILED) {
+			::close(fd);
+			ptr = static_cast<const char*>(p);
+			sz = st.st_size;
+			mapped = true;
+			return true;
+		}
+	}
+	::close(fd);
+#endif
+	auto in = ifstream(file_path, ios_base::binary);
+	if (in.fail())
+		return false;
+	auto ss = ostringstream();
+	ss << in.rdbuf();
+	buffer = ss.str();
+	ptr = buffer.data();
+	sz = buffer.size();
+	return true;
+}
+
+/**
+ * @internal
+ * @brief Unmaps or releases the content of the file.
+ */
+auto Mapped_File::close() -> void
+{
+#ifdef _POSIX_VERSION
+	if (mapped)
+		munmap(const_cast<char*>(ptr), sz);
+#endif
+	ptr = nullptr;
+	sz = 0;
+	mapped = false;
+	buffer.clear();
+	buffer.shrink_to_fit();
+}
+
 auto replace_ascii_char(string& s, char from, char to) -> void
 {
 	for (auto i = s.find(from); i != s.npos; i = s.find(from, i + 1)) {
@@ -461,5 +1162,5 @@ auto count_appereances_of(string_view haystack, string_view needles) -> size_t
 	return ret;
 }
 
-} // namespace v5
+} // namespace v6
 } // namespace nuspell
@@ -46,7 +46,7 @@
 struct UConverter; // unicode/ucnv.h
 
 namespace nuspell {
-inline namespace v5 {
+inline namespace v6 {
 
 auto split(std::string_view s, char sep, std::vector<std::string>& out)
     -> std::vector<std::string>&;
@@ -59,12 +59,12 @@ NUSPELL_EXPORT auto utf32_to_utf8(std::u32string_view in, std::string& out)
 NUSPELL_EXPORT auto utf32_to_utf8(std::u32string_view in) -> std::string;
 
 auto valid_utf8_to_32(std::string_view in, std::u32string& out) -> void;
-auto valid_utf8_to_32(std::string_view in) -> std::u32string;
+NUSPELL_EXPORT auto valid_utf8_to_32(std::string_view in) -> std::u32string;
 
 auto utf8_to_16(std::string_view in) -> std::u16string;
 auto utf8_to_16(std::string_view in, std::u16string& out) -> bool;
 
-auto validate_utf8(std::string_view s) -> bool;
+NUSPELL_EXPORT auto validate_utf8(std::string_view s) -> bool;
 
 NUSPELL_EXPORT auto is_all_ascii(std::string_view s) -> bool;
 
@@ -87,14 +87,16 @@ auto to_upper_ascii(std::string& s) -> void;
 
 auto to_upper(std::string_view in, const icu::Locale& loc, std::string& out)
     -> void;
-auto to_title(std::string_view in, const icu::Locale& loc, std::string& out)
-    -> void;
-auto to_lower(std::u32string_view in, const icu::Locale& loc,
-              std::u32string& out) -> void;
+NUSPELL_EXPORT auto to_title(std::string_view in, const icu::Locale& loc,
+                             std::string& out) -> void;
+NUSPELL_EXPORT auto to_lower(std::u32string_view in, const icu::Locale& loc,
+                             std::u32string& out) -> void;
 auto to_lower(std::string_view in, const icu::Locale& loc, std::string& out)
     -> void;
-auto to_lower_char_at(std::string& s, size_t i, const icu::Locale& loc) -> void;
-auto to_title_char_at(std::string& s, size_t i, const icu::Locale& loc) -> void;
+NUSPELL_EXPORT auto to_lower_char_at(std::string& s, size_t i,
+                                     const icu::Locale& loc) -> void;
+NUSPELL_EXPORT auto to_title_char_at(std::string& s, size_t i,
+                                     const icu::Locale& loc) -> void;
 
 /**
  * @internal
@@ -193,6 +195,32 @@ class Setlocale_To_C_In_Scope {
 };
 #endif
 
+/**
+ * @internal
+ * @brief Read-only view of the whole content of a file.
+ *
+ * On POSIX systems the file is mapped into memory with mmap(), elsewhere it is
+ * read into an internal buffer.
+ */
+class Mapped_File {
+	const char* ptr = nullptr;
+	size_t sz = 0;
+	bool mapped = false;
+	std::string buffer;
+
+      public:
+	Mapped_File() = default;
+	explicit Mapped_File(const std::string& file_path) { open(file_path); }
+	~Mapped_File() { close(); }
+	Mapped_File(const Mapped_File&) = delete;
+	auto operator=(const Mapped_File&) -> Mapped_File& = delete;
+
+	auto open(const std::string& file_path) -> bool;
+	auto close() -> void;
+	auto is_open() const { return ptr != nullptr; }
+	auto view() const { return std::string_view(ptr, sz); }
+};
+
 auto replace_ascii_char(std::string& s, char from, char to) -> void;
 auto erase_chars(std::string& s, std::string_view erase_chars) -> void;
 NUSPELL_EXPORT auto is_number(std::string_view s) -> bool;
@@ -223,6 +251,6 @@ auto end_ptr(T& x)
 {
 	return x.data() + x.size();
 }
-} // namespace v5
+} // namespace v6
 } // namespace nuspell
 #endif // NUSPELL_UTILS_HXX
@@ -0,0 +1,168 @@
+/* Copyright 2021 Dimitrij Mijoski
+ *
+ * This file is part of Nuspell.
+ *
+ * Nuspell is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Nuspell is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with Nuspell.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Benchmarks of the ngram suggestion kernels and of suggest().
+//
+// Usage: bench [DICTIONARY [WORDS_FILE]]
+//
+// Without arguments only the kernels are timed, on pseudo-random strings.
+// With a dictionary, given as a path without the .aff and .dic extensions,
+// suggest() is timed for each word read from WORDS_FILE or the standard
+// input, with the ngram image, the trigram index and the threads disabled
+// and enabled. The cache of suggest() results is left disabled. Build in
+// release mode to get meaningful numbers.
+
+#include <nuspell/dictionary.hxx>
+
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+using namespace std;
+using namespace nuspell;
+
+namespace {
+auto random_words(size_t count, size_t len, mt19937& rng) -> vector<u32string>
+{
+	auto letter = uniform_int_distribution<int>('a', 'z');
+	auto words = vector<u32string>(count);
+	for (auto& w : words)
+		for (size_t i = 0; i != len; ++i)
+			w += char32_t(letter(rng));
+	return words;
+}
+
+// Calls f for each pair of words and prints the mean time of a call.
+template <class F>
+auto time_pairs(const char* name, const vector<u32string>& words, F f) -> void
+{
+	auto sink = ptrdiff_t(0);
+	auto calls = size_t(0);
+	auto t1 = chrono::steady_clock::now();
+	for (auto& a : words)
+		for (auto& b : words) {
+			sink += f(a, b);
+			++calls;
+		}
+	auto t2 = chrono::steady_clock::now();
+	auto ns = chrono::duration<double, nano>(t2 - t1).count() / calls;
+	cout << left << setw(40) << name << right << setw(10) << fixed
+	     << setprecision(1) << ns << " ns  (checksum " << sink << ")\n";
+}
+
+auto bench_kernels() -> void
+{
+	auto rng = mt19937(12345);
+	auto lcs_buf = vector<size_t>();
+	for (auto len : {size_t(7), size_t(12), size_t(40)}) {
+		auto words = random_words(300, len, rng);
+		cout << "Kernels, words of " << len << " characters\n";
+		time_pairs("  ngram_similarity_low_level n=3", words,
+		           [](auto& a, auto& b) {
+			           return ngram_similarity_low_level(3, a, b);
+		           });
+		time_pairs("  ngram_similarity_by_find n=3", words,
+		           [](auto& a, auto& b) {
+			           return ngram_similarity_by_find(3, a, b);
+		           });
+		time_pairs("  ngram_similarity_weighted_low_level", words,
+		           [](auto& a, auto& b) {
+			           return ngram_similarity_weighted_low_level(
+			               a.size(), a, b);
+		           });
+		time_pairs("  ngram_similarity_weighted_by_find", words,
+		           [](auto& a, auto& b) {
+			           return ngram_similarity_weighted_by_find(
+			               a.size(), a, b);
+		           });
+		time_pairs("  longest_common_subsequence_length", words,
+		           [&](auto& a, auto& b) {
+			           return longest_common_subsequence_length(
+			               a, b, lcs_buf);
+		           });
+	}
+}
+
+auto bench_suggest(Dictionary& dic, const vector<string>& words) -> void
+{
+	struct Config {
+		const char* name;
+		bool image;
+		bool index;
+		size_t threads;
+	};
+	auto configs = {Config{"word list", false, false, 1},
+	                Config{"image", true, false, 1},
+	                Config{"image and index", true, true, 1},
+	                Config{"image, 4 threads", true, false, 4}};
+	auto sugs = vector<string>();
+	for (auto& c : configs) {
+		dic.set_ngram_image_enabled(c.image);
+		dic.set_ngram_index_enabled(c.index);
+		dic.set_ngram_threads(c.threads);
+		// The first call builds the image, it is not measured.
+		dic.suggest("bench", sugs);
+		auto num_sugs = size_t(0);
+		auto t1 = chrono::steady_clock::now();
+		for (auto& w : words) {
+			dic.suggest(w, sugs);
+			num_sugs += size(sugs);
+		}
+		auto t2 = chrono::steady_clock::now();
+		auto us = chrono::duration<double, micro>(t2 - t1).count() /
+		          max(size(words), size_t(1));
+		cout << "  suggest(), " << left << setw(28) << c.name << right
+		     << setw(10) << fixed << setprecision(1) << us
+		     << " us  (" << num_sugs << " suggestions)\n";
+	}
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	ios_base::sync_with_stdio(false);
+	bench_kernels();
+	if (argc < 2)
+		return 0;
+	auto dic = Dictionary();
+	try {
+		dic = Dictionary::load_from_path(argv[1]);
+	}
+	catch (const Dictionary_Loading_Error& e) {
+		cerr << e.what() << '\n';
+		return 1;
+	}
+	auto words = vector<string>();
+	auto file = ifstream();
+	if (argc > 2) {
+		file.open(argv[2]);
+		if (!file.is_open()) {
+			cerr << "Can't open " << argv[2] << '\n';
+			return 1;
+		}
+	}
+	auto& in = argc > 2 ? file : cin;
+	for (auto w = string(); getline(in, w);)
+		if (!w.empty())
+			words.push_back(w);
+	cout << "Dictionary " << argv[1] << ", " << size(words) << " words\n";
+	bench_suggest(dic, words);
+	return 0;
+}
@@ -18,6 +18,7 @@
 
 #include <nuspell/dictionary.hxx>
 
+#include <cstdio>
 #include <fstream>
 #include <iostream>
 
@@ -25,9 +26,28 @@ using namespace std;
 
 int main(int argc, char* argv[])
 {
-	if (argc < 2)
+	// The options change how the dictionary is held before testing.
+	// --compiled saves it into the compiled format and loads it back,
+	// --freeze freezes its word list and --ngram-image enables the image
+	// for the ngram suggestions.
+	auto compiled = false;
+	auto frozen = false;
+	auto ngram_image = false;
+	auto i = 1;
+	for (; i < argc && argv[i][0] == '-' && argv[i][1] == '-'; ++i) {
+		auto opt = string_view(argv[i]);
+		if (opt == "--compiled")
+			compiled = true;
+		else if (opt == "--freeze")
+			frozen = true;
+		else if (opt == "--ngram-image")
+			ngram_image = true;
+		else
+			return 3;
+	}
+	if (i + 1 != argc)
 		return 3;
-	auto test = string(argv[1]);
+	auto test = string(argv[i]);
 	if (test.size() < 4) {
 		cerr << "Invalid test type\n";
 		return 3;
@@ -41,6 +61,22 @@ int main(int argc, char* argv[])
 	file.close();
 	test.erase(test.size() - 4);
 	auto d = nuspell::Dictionary::load_from_path(test);
+	if (compiled) {
+		// The path has the test type, so the .dic and the .sug test of
+		// the same dictionary can run in parallel.
+		auto path = test.substr(test.find_last_of("/\\") + 1);
+		path += type;
+		path += ".compiled";
+		d.save_compiled(path);
+		d = nuspell::Dictionary::load_compiled(path);
+		remove(path.c_str());
+	}
+	if (frozen && !d.freeze()) {
+		cerr << "Can not freeze the dictionary\n";
+		return 2;
+	}
+	if (ngram_image)
+		d.set_ngram_image_enabled(true);
 	auto word = string();
 	if (type == ".dic") {
 		auto error = vector<string>();
@@ -19,10 +19,104 @@
 #include <catch2/catch.hpp>
 #include <nuspell/dictionary.hxx>
 #include <nuspell/utils.hxx>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <unicode/ustring.h>
+
+#ifdef _WIN32
+#include <malloc.h>
+#endif
 
 using namespace std;
 using namespace nuspell;
 
+// Counting allocator for the tests that check that no allocation happens.
+// All forms of new and delete go through the two helpers. They are not
+// inlined, so that the compiler does not pair the calls of malloc and free
+// with the calls of new and delete and warn about a mismatch.
+static atomic<size_t> num_allocations = 0;
+[[gnu::noinline]] static auto counted_alloc(size_t size, size_t alignment)
+    -> void*
+{
+	++num_allocations;
+	size = (max(size, size_t(1)) - 1) / alignment * alignment + alignment;
+#ifdef _WIN32
+	auto p = _aligned_malloc(size, alignment);
+#else
+	auto p = aligned_alloc(alignment, size);
+#endif
+	if (!p)
+		throw bad_alloc();
+	return p;
+}
+[[gnu::noinline]] static auto counted_free(void* p) noexcept -> void
+{
+#ifdef _WIN32
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+auto operator new(size_t size) -> void*
+{
+	return counted_alloc(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+auto operator new[](size_t size) -> void*
+{
+	return counted_alloc(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+auto operator new(size_t size, align_val_t al) -> void*
+{
+	return counted_alloc(size, size_t(al));
+}
+auto operator new[](size_t size, align_val_t al) -> void*
+{
+	return counted_alloc(size, size_t(al));
+}
+auto operator delete(void* p) noexcept -> void { counted_free(p); }
+auto operator delete[](void* p) noexcept -> void { counted_free(p); }
+auto operator delete(void* p, size_t) noexcept -> void { counted_free(p); }
+auto operator delete[](void* p, size_t) noexcept -> void { counted_free(p); }
+auto operator delete(void* p, align_val_t) noexcept -> void
+{
+	counted_free(p);
+}
+auto operator delete[](void* p, align_val_t) noexcept -> void
+{
+	counted_free(p);
+}
+auto operator delete(void* p, size_t, align_val_t) noexcept -> void
+{
+	counted_free(p);
+}
+auto operator delete[](void* p, size_t, align_val_t) noexcept -> void
+{
+	counted_free(p);
+}
+
+// Reproducible pseudo-random strings for the tests that compare with a
+// reference implementation. The characters alternate between ASCII and the
+// supplementary planes.
+struct Random_Strings {
+	uint32_t state;
+
+	auto next() -> uint32_t { return state = state * 1103515245 + 12345; }
+	auto get(size_t len, char32_t alphabet) -> u32string
+	{
+		auto s = u32string();
+		for (size_t i = 0; i != len; ++i) {
+			auto c = char32_t(next() >> 16) % alphabet;
+			s += c % 2 ? U'a' + c : 0x1F600 + c;
+		}
+		return s;
+	}
+};
+
 TEST_CASE("Subrange")
 {
 	auto str = "abc"s;
@@ -161,6 +255,262 @@ TEST_CASE("Hash_Multimap")
 	REQUIRE(res.first == res.second);
 	res = h.equal_range("");
 	REQUIRE(res.first == res.second);
+
+	for (auto i = 0; i != 1000; ++i) {
+		h.emplace(to_string(i), i);
+		if (i % 3 == 0)
+			h.emplace(to_string(i), -i);
+	}
+	h.emplace("hello", 3);
+	REQUIRE(h.size() == 1337);
+	res = h.equal_range("hello");
+	REQUIRE(distance(res.first, res.second) == 3);
+	REQUIRE(*next(res.first, 2) == pair("hello"s, 3));
+	for (auto i = 0; i != 1000; ++i) {
+		res = h.equal_range(to_string(i));
+		REQUIRE(distance(res.first, res.second) == 1 + (i % 3 == 0));
+		REQUIRE(res.first->second == i);
+		if (i % 3 == 0)
+			REQUIRE(next(res.first)->second == -i);
+	}
+	res = h.equal_range("1000");
+	REQUIRE(res.first == res.second);
+	REQUIRE(h.equal_range("hello", hash<string>()("hello")) ==
+	        h.equal_range("hello"));
+
+	auto cnt = size_t(0);
+	for (size_t i = 0; i != h.bucket_count(); ++i)
+		for (auto& x : h.bucket_data(i))
+			cnt += !x.first.empty();
+	REQUIRE(cnt == h.size());
+}
+
+TEST_CASE("Perfect_Hash_Multimap")
+{
+	auto h = Hash_Multimap<string, int>();
+	auto p = Perfect_Hash_Multimap<string, int>();
+	REQUIRE(p.build(h));
+	REQUIRE(p.empty());
+	auto res = p.equal_range("hello");
+	REQUIRE(res.first == res.second);
+
+	for (auto i = 0; i != 10000; ++i) {
+		h.emplace(to_string(i), i);
+		if (i % 3 == 0)
+			h.emplace(to_string(i), -i);
+	}
+	h.emplace("", 7);
+	REQUIRE(p.build(h));
+	REQUIRE(p.size() == h.size());
+	for (auto i = 0; i != 10000; ++i) {
+		res = p.equal_range(to_string(i));
+		REQUIRE(distance(res.first, res.second) == 1 + (i % 3 == 0));
+		REQUIRE(res.first->second == i);
+		if (i % 3 == 0)
+			REQUIRE(next(res.first)->second == -i);
+	}
+	REQUIRE(p.equal_range("42", hash<string>()("42")) ==
+	        p.equal_range("42"));
+	res = p.equal_range("");
+	REQUIRE(distance(res.first, res.second) == 1);
+	REQUIRE(res.first->second == 7);
+	for (auto i = 10000; i != 20000; ++i) {
+		res = p.equal_range(to_string(i));
+		REQUIRE(res.first == res.second);
+	}
+
+	REQUIRE(p.bucket_count() == h.size());
+	auto j = size_t(0);
+	for (size_t i = 0; i != h.bucket_count(); ++i)
+		for (auto& x : h.bucket_data(i))
+			REQUIRE(*p.bucket_data(j++).begin() == x);
+}
+
+TEST_CASE("Bloom_Filter")
+{
+	auto f = Bloom_Filter();
+	REQUIRE(f.empty());
+	REQUIRE(f.might_contain("hello"));
+
+	f = Bloom_Filter(10000);
+	REQUIRE_FALSE(f.empty());
+	for (auto i = 0; i != 10000; ++i)
+		f.insert(to_string(i));
+	for (auto i = 0; i != 10000; ++i)
+		REQUIRE(f.might_contain(to_string(i)));
+	auto false_positives = 0;
+	for (auto i = 10000; i != 110000; ++i)
+		false_positives += f.might_contain(to_string(i));
+	REQUIRE(false_positives < 1000);
+}
+
+TEST_CASE("Clock_Cache")
+{
+	auto c = Clock_Cache<int>(4);
+	auto x = 0;
+	REQUIRE_FALSE(c.get("a", x));
+	c.put("a", 1);
+	c.put("b", 2);
+	c.put("c", 3);
+	c.put("d", 4);
+	REQUIRE(c.get("a", x));
+	REQUIRE(x == 1);
+	c.put("e", 5);
+	REQUIRE_FALSE(c.get("b", x));
+	REQUIRE(c.get("a", x));
+	REQUIRE(c.get("e", x));
+	REQUIRE(x == 5);
+	c.put("a", 10);
+	REQUIRE(c.get("a", x));
+	REQUIRE(x == 10);
+
+	auto st = c.statistics();
+	REQUIRE(st.capacity == 4);
+	REQUIRE(st.charge == 4);
+	REQUIRE(st.size == 4);
+	REQUIRE(st.hits == 4);
+	REQUIRE(st.misses == 2);
+	REQUIRE(st.evictions == 1);
+
+	auto w = Clock_Cache<int>(3);
+	w.put("a", 1, 1, 3);
+	w.put("b", 2);
+	w.put("c", 3);
+	w.put("d", 4);
+	w.put("e", 5);
+	w.put("f", 6);
+	REQUIRE(w.get("a", x));
+	REQUIRE(w.get("f", x));
+	REQUIRE_FALSE(w.get("b", x));
+	REQUIRE(w.statistics().size == 3);
+
+	auto m = Clock_Cache<int>(10);
+	m.put("x", 1, 6);
+	m.put("y", 2, 6);
+	REQUIRE_FALSE(m.get("x", x));
+	REQUIRE(m.get("y", x));
+	m.put("z", 3, 11);
+	REQUIRE_FALSE(m.get("z", x));
+	m.put("y", 4, 2);
+	m.put("z", 5, 8);
+	REQUIRE(m.get("y", x));
+	REQUIRE(x == 4);
+	st = m.statistics();
+	REQUIRE(st.charge == 10);
+	REQUIRE(st.size == 2);
+
+	auto big = Clock_Cache<int>(10000);
+	for (auto i = 0; i != 20000; ++i)
+		big.put(to_string(i), i);
+	st = big.statistics();
+	REQUIRE(st.capacity >= 10000);
+	REQUIRE(st.size <= st.capacity);
+	REQUIRE(big.get("19999", x));
+	REQUIRE(x == 19999);
+}
+
+TEST_CASE("Word_List")
+{
+	auto w = Word_List();
+	auto long_word = string(100000, 'a');
+	auto word = "hello"s;
+	w.emplace(word, u"AB");
+	w.emplace(word, u"C");
+	w.emplace(long_word, u"");
+	w.emplace("world", u"BA");
+	word[0] = 'j';
+	REQUIRE(w.size() == 4);
+	REQUIRE(w.distinct_flag_sets().size() == 3);
+	REQUIRE(w.equal_range("world").first->second ==
+	        w.equal_range("hello").first->second);
+	auto res = w.equal_range("hello");
+	REQUIRE(distance(res.first, res.second) == 2);
+	REQUIRE(res.first->first == "hello");
+	REQUIRE(res.first->first.data() == next(res.first)->first.data());
+	REQUIRE(res.first->second->str() == u"AB");
+	REQUIRE(next(res.first)->second->str() == u"C");
+	REQUIRE(w.equal_range(long_word).first->first == long_word);
+	REQUIRE(w.equal_range("jello").first == w.equal_range("jello").second);
+	auto text = "say hello world"sv;
+	auto slice = text.substr(4, 5);
+	REQUIRE(w.equal_range(slice, Word_List::hash(slice)) ==
+	        w.equal_range("hello"));
+
+	auto w2 = w;
+	w = Word_List();
+	REQUIRE(w2.distinct_flag_sets().size() == 3);
+	res = w2.equal_range("hello");
+	REQUIRE(distance(res.first, res.second) == 2);
+	REQUIRE(res.first->second == w2.equal_range("world").first->second);
+	REQUIRE(res.first->first == "hello");
+	REQUIRE(next(res.first)->second->str() == u"C");
+
+	auto r = Role_Flags();
+	r.set(ROLE_FORBIDDENWORD, u'C');
+	r.set(ROLE_NEEDAFFIX, u'A');
+	r.set(ROLE_KEEPCASE, u'A');
+	w2.set_role_flags(r);
+	res = w2.equal_range("hello");
+	REQUIRE(res.first->second->roles == (ROLE_NEEDAFFIX | ROLE_KEEPCASE));
+	REQUIRE(next(res.first)->second->roles == ROLE_FORBIDDENWORD);
+	REQUIRE(w2.equal_range(long_word).first->second->roles == 0);
+	w2.emplace("foo", u"XC");
+	REQUIRE(w2.equal_range("foo").first->second->roles ==
+	        ROLE_FORBIDDENWORD);
+
+	auto order = vector<string_view>();
+	for (size_t i = 0; i != w2.bucket_count(); ++i)
+		for (auto& x : w2.bucket_data(i))
+			order.push_back(x.first);
+	REQUIRE(w2.freeze());
+	REQUIRE(w2.is_frozen());
+	REQUIRE(w2.size() == 5);
+	res = w2.equal_range("hello");
+	REQUIRE(distance(res.first, res.second) == 2);
+	REQUIRE(next(res.first)->second->str() == u"C");
+	REQUIRE(w2.equal_range("jello").first == w2.equal_range("jello").second);
+	auto frozen_order = vector<string_view>();
+	for (size_t i = 0; i != w2.bucket_count(); ++i)
+		for (auto& x : w2.bucket_data(i))
+			frozen_order.push_back(x.first);
+	REQUIRE(frozen_order == order);
+	auto w4 = w2;
+	REQUIRE(w4.is_frozen());
+	res = w4.equal_range("hello");
+	auto res2 = w2.equal_range("hello");
+	REQUIRE(distance(res.first, res.second) == 2);
+	REQUIRE(res.first->first == "hello");
+	REQUIRE(res.first->first.data() != res2.first->first.data());
+	REQUIRE(res.first->first.data() == next(res.first)->first.data());
+	REQUIRE(res.first->second != res2.first->second);
+	REQUIRE(res.first->second == w4.equal_range("world").first->second);
+	REQUIRE(next(res.first)->second->roles == ROLE_FORBIDDENWORD);
+	REQUIRE(w4.equal_range("foo").first->first == "foo");
+	REQUIRE(w2.might_contain("jello"));
+	w2.build_filter();
+	REQUIRE(w2.might_contain("hello"));
+	REQUIRE(w2.might_contain_hash(Word_List::hash("hello")));
+	REQUIRE(w2.might_contain(long_word));
+	w2.emplace("bar", u"");
+	REQUIRE(w2.might_contain("bar"));
+	REQUIRE_FALSE(w2.is_frozen());
+	REQUIRE(w2.size() == 6);
+	REQUIRE(distance(w2.equal_range("hello").first,
+	                 w2.equal_range("hello").second) == 2);
+
+	auto w3 = move(w2);
+	REQUIRE(w2.empty());
+	w2.emplace("moved", u"A");
+	w2.emplace("from", u"B");
+	REQUIRE(w2.size() == 2);
+	REQUIRE(w3.size() == 6);
+	REQUIRE(w3.equal_range("bar").first->first == "bar");
+	REQUIRE(w3.equal_range("moved").first == w3.equal_range("moved").second);
+	w2 = move(w3);
+	REQUIRE(w3.empty());
+	w3.emplace("again", u"");
+	REQUIRE(w2.size() == 6);
+	REQUIRE(w2.equal_range("hello").first->first == "hello");
 }
 
 TEST_CASE("Condition")
@@ -295,6 +645,14 @@ TEST_CASE("Condition")
 	REQUIRE_FALSE(c.match_prefix("abc ШШШ \u2345z\U00011111X"));
 	REQUIRE_FALSE(c.match_prefix("abc АБВ\u2345 t\U00011112Xопop"));
 	REQUIRE_FALSE(c.match_prefix("abc АБВ \u2345z\u1234X"));
+
+	c = "[äöüß][^äöü]";
+	REQUIRE(c.match_prefix("ßa"));
+	REQUIRE(c.match_prefix("äÄ"));
+	REQUIRE(c.match_suffix("Straße"));
+	REQUIRE_FALSE(c.match_prefix("aä"));
+	REQUIRE_FALSE(c.match_prefix("öü"));
+	REQUIRE_FALSE(c.match_suffix("ßä"));
 }
 
 TEST_CASE("Prefix")
@@ -325,6 +683,22 @@ TEST_CASE("Prefix_Multiset")
 	auto it = set.iterate_prefixes_of(word);
 	out.assign(begin(it), end(it));
 	REQUIRE(out == expected);
+
+	word = "";
+	it = set.iterate_prefixes_of(word);
+	out.assign(begin(it), end(it));
+	REQUIRE(out == vector<string>{"", ""});
+	word = "qwe";
+	it = set.iterate_prefixes_of(word);
+	out.assign(begin(it), end(it));
+	REQUIRE(out == vector<string>{"", ""});
+
+	auto empty_set = Prefix_Multiset<string>();
+	it = empty_set.iterate_prefixes_of(word);
+	REQUIRE_FALSE(it);
+	out.clear();
+	empty_set.copy_all_prefixes_of(word, back_inserter(out));
+	REQUIRE(out.empty());
 }
 
 TEST_CASE("Suffix_Multiset")
@@ -419,12 +793,82 @@ TEST_CASE("utf32_to_utf8()")
 	        "abcАбвг\uABCD\u1234\U0010ABCD");
 }
 
+TEST_CASE("valid_utf8_to_32()")
+{
+	REQUIRE(valid_utf8_to_32("") == U"");
+	REQUIRE(valid_utf8_to_32("abcАбвг\uABCD\u1234\U0010ABCD") ==
+	        U"abcАбвг\uABCD\u1234\U0010ABCD");
+
+	// Non-ASCII code points at all positions around the SIMD blocks.
+	for (auto cp : {U'\x7F', U'é', U'Ж', U'\uABCD', U'\U0010ABCD'}) {
+		for (size_t n = 0; n != 40; ++n) {
+			for (size_t i = 0; i <= n; ++i) {
+				auto u32 = u32string(n, U'a');
+				u32.insert(i, 1, cp);
+				auto u8 = utf32_to_utf8(u32);
+				REQUIRE(valid_utf8_to_32(u8) == u32);
+				REQUIRE(utf32_to_utf8(valid_utf8_to_32(u8)) ==
+				        u8);
+			}
+		}
+	}
+}
+
 TEST_CASE("is_all_ascii()")
 {
 	REQUIRE(is_all_ascii(""));
 	REQUIRE(is_all_ascii("abcd\x7f"));
 	REQUIRE_FALSE(is_all_ascii("abcd\x80"));
 	REQUIRE_FALSE(is_all_ascii("abcd\xFF"));
+	for (auto i = 0; i != 70; ++i) {
+		auto s = string(70, 'a');
+		REQUIRE(is_all_ascii(s));
+		s[i] = '\x80';
+		REQUIRE_FALSE(is_all_ascii(s));
+	}
+}
+
+TEST_CASE("validate_utf8()")
+{
+	auto icu_validate = [](string_view s) {
+		auto err = U_ZERO_ERROR;
+		u_strFromUTF8(nullptr, 0, nullptr, data(s), size(s), &err);
+		return err == U_BUFFER_OVERFLOW_ERROR || U_SUCCESS(err);
+	};
+	CHECK(validate_utf8(""));
+	CHECK(validate_utf8("abc"));
+	CHECK(validate_utf8("\xF4\x8F\xBF\xBF"));
+	CHECK_FALSE(validate_utf8("\xF4\x90\x80\x80"));
+	CHECK_FALSE(validate_utf8("\xED\xA0\x80"));
+	CHECK_FALSE(validate_utf8("\xC0\xAF"));
+
+	// All pairs and interesting triples and quadruples of bytes at all
+	// positions around the 16 and 32 byte blocks of the SIMD code.
+	auto bytes = string("\x00\x41\x7F\x80\x8F\x90\x9F\xA0\xBF\xC0\xC1"
+	                    "\xC2\xDF\xE0\xE1\xEC\xED\xEE\xEF\xF0\xF1"
+	                    "\xF3\xF4\xF5\xFF",
+	                    25);
+	auto seqs = vector<string>();
+	for (auto i = 0; i != 256; ++i)
+		for (auto j = 0; j != 256; ++j)
+			seqs.push_back({char(i), char(j)});
+	for (auto a : bytes)
+		for (auto b : bytes)
+			for (auto c : bytes) {
+				seqs.push_back({a, b, c});
+				for (auto d : {'\x41', '\x80', '\xBF', '\xC3'})
+					seqs.push_back({a, b, c, d});
+			}
+	auto num_mismatches = 0;
+	for (auto& seq : seqs) {
+		for (auto pos : {0, 13, 30, 31, 62}) {
+			auto s = string(pos, 'a') + seq + string(40, 'b');
+			num_mismatches += validate_utf8(s) != icu_validate(s);
+			s.resize(pos + size(seq));
+			num_mismatches += validate_utf8(s) != icu_validate(s);
+		}
+	}
+	CHECK(num_mismatches == 0);
 }
 
 TEST_CASE("latin1_to_ucs2()")
@@ -461,6 +905,65 @@ TEST_CASE("case conversion")
 	CHECK(to_title(in, l) == "İstanbulı");
 }
 
+TEST_CASE("case conversion fast paths")
+{
+	// The fast paths must give the same results as UnicodeString.
+	auto icu_map = [](string_view in, const icu::Locale& l, char op) {
+		auto us = icu::UnicodeString::fromUTF8(
+		    icu::StringPiece(data(in), size(in)));
+		if (op == 'l')
+			us.toLower(l);
+		else if (op == 'u')
+			us.toUpper(l);
+		else
+			us.toTitle(nullptr, l);
+		auto out = string();
+		us.toUTF8String(out);
+		return out;
+	};
+	auto words = vector<string>();
+	for (char32_t c = 1; c != 0x100; ++c) {
+		auto cp = utf32_to_utf8(u32string(1, c));
+		words.push_back(cp);
+		words.push_back(cp + "ab");
+		words.push_back("Ab" + cp + "c");
+	}
+	words.push_back("grüßEN");
+	words.push_back("ÀÉÎÕÜ ÿ");
+	words.push_back("ijssel");
+	words.push_back("ΟΔΟΣ ΣΑΣ");
+	words.push_back("привет");
+	words.push_back("İstanbul");
+	words.push_back("ǆemal");
+	words.push_back("ﬁx ŉ");
+	for (auto loc : {"", "de", "el", "nl", "tr", "lt"}) {
+		auto l = icu::Locale(loc);
+		for (auto& w : words) {
+			CHECK(to_lower(w, l) == icu_map(w, l, 'l'));
+			CHECK(to_upper(w, l) == icu_map(w, l, 'u'));
+			CHECK(to_title(w, l) == icu_map(w, l, 't'));
+
+			auto w32 = valid_utf8_to_32(w);
+			auto out = u32string();
+			to_lower(w32, l, out);
+			CHECK(utf32_to_utf8(out) == icu_map(w, l, 'l'));
+
+			auto s = w;
+			to_lower_char_at(s, 0, l);
+			auto first_len = valid_u8_next_cp(w, 0).end_i;
+			auto first = w.substr(0, first_len);
+			CHECK(s == icu_map(first, l, 'l') + w.substr(first_len));
+			s = w;
+			to_title_char_at(s, 0, l);
+			CHECK(s == icu_map(first, l, 't') + w.substr(first_len));
+
+			s = w;
+			to_title(s, l, s);
+			CHECK(s == icu_map(w, l, 't'));
+		}
+	}
+}
+
 TEST_CASE("classify_casing()")
 {
 	REQUIRE(classify_casing("") == Casing::SMALL);
@@ -496,3 +999,643 @@ TEST_CASE("Dict_Base::forgotten_char_suggest()")
 	d.forgotten_char_suggest(in, sugs);
 	REQUIRE(sugs == vector{"абвШгд"s, "абвгдИ"s, "Забвгд"s});
 }
+
+TEST_CASE("Checker::find_word()")
+{
+	auto d = nuspell::Suggester();
+	d.words.emplace("hello", u"");
+	d.words.emplace("world", u"");
+	d.words.build_filter();
+	auto hash = [](string_view w) { return Word_List::hash(w); };
+	using Range = Lookup_Memo::Range;
+
+	auto memo = Lookup_Memo();
+	CHECK(memo.find("", 0) == nullptr);
+	auto scope = Lookup_Memo_Scope(memo);
+	auto hello = d.find_word("hello");
+	REQUIRE(hello.first != hello.second);
+	REQUIRE(memo.find("hello", hash("hello")) != nullptr);
+	CHECK(*memo.find("hello", hash("hello")) == hello);
+	auto none = d.find_word("xyz");
+	CHECK(none.first == none.second);
+	CHECK(memo.find("xyz", hash("xyz")) != nullptr);
+
+	// Repeated lookups are answered from the memo, as this shows.
+	auto fake = Range(hello.first, hello.first);
+	memo.insert("hello", hash("hello"), fake);
+	CHECK(d.find_word("hello") == fake);
+
+	// Keys that share an entry do not mix up their results.
+	auto m = Lookup_Memo();
+	auto other = Range(hello.second, hello.second);
+	m.insert("aaa", 5, hello);
+	REQUIRE(m.find("aaa", 5) != nullptr);
+	CHECK(*m.find("aaa", 5) == hello);
+	CHECK(m.find("bbb", 5) == nullptr);
+	CHECK(m.find("aaa", 5 + 64) == nullptr);
+	m.insert("bbb", 5 + 64, other);
+	CHECK(m.find("aaa", 5) == nullptr);
+	REQUIRE(m.find("bbb", 5 + 64) != nullptr);
+	CHECK(*m.find("bbb", 5 + 64) == other);
+
+	// Keys that do not fit into the key buffer are not stored.
+	auto m2 = Lookup_Memo();
+	auto scope2 = Lookup_Memo_Scope(m2);
+	auto long_key = string(2045, 'x');
+	m2.insert(long_key, 1, other);
+	CHECK(m2.find(long_key, 1) != nullptr);
+	auto world = d.find_word("world");
+	CHECK(world.first != world.second);
+	CHECK(m2.find("world", hash("world")) == nullptr);
+	CHECK(d.find_word("world") == world);
+}
+
+TEST_CASE("Dictionary load_compiled rejects bad files")
+{
+	auto aff = istringstream(R"(SET UTF-8
+FLAG long
+SFX Sa Y 1
+SFX Sa 0 s .
+PFX Un Y 1
+PFX Un 0 un [^x]
+COMPOUNDFLAG Cx
+REP 1
+REP ph f
+)");
+	auto dic = istringstream("3\nhello/SaUn\nworld/Sa\nfoo/Cx\n");
+	auto d = Dictionary::load_from_aff_dic(aff, dic);
+	auto path = string("unit_test_bad_file.compiled");
+	d.save_compiled(path);
+	auto file = ifstream(path, ios_base::binary);
+	auto good = string(istreambuf_iterator<char>(file), {});
+	file.close();
+	REQUIRE(good.size() > 30);
+
+	auto load = [&](const string& data) {
+		auto out = ofstream(path, ios_base::binary | ios_base::trunc);
+		out << data;
+		out.close();
+		return Dictionary::load_compiled(path);
+	};
+	auto put_uint = [](string& data, size_t i, uint64_t x, size_t n) {
+		for (size_t j = 0; j != n; ++j, x >>= 8)
+			data[i + j] = char(x & 0xFF);
+	};
+	auto loaded = load(good);
+	CHECK(loaded.spell("unhellos"));
+	CHECK(loaded.spell("foofoo"));
+
+	for (size_t n = 0; n != good.size(); ++n)
+		CHECK_THROWS_AS(load(good.substr(0, n)),
+		                Dictionary_Loading_Error);
+
+	auto bad = good;
+	bad[0] = 'X';
+	CHECK_THROWS_AS(load(bad), Dictionary_Loading_Error);
+	bad = good;
+	bad[8] += 1; // version
+	CHECK_THROWS_AS(load(bad), Dictionary_Loading_Error);
+
+	// The words start with eight counts: the capacity of the word list,
+	// 16, the number of words and of distinct words, 3 and 3, and others.
+	// Then come the entries of the words, each with the offset and the
+	// size of the key and the index of the flag set.
+	auto counts_pos =
+	    good.find(string("\x10\0\0\0\0\0\0\0\3\0\0\0\0\0\0\0"
+	                     "\3\0\0\0\0\0\0\0",
+	                     24));
+	REQUIRE(counts_pos != good.npos);
+	auto entries_pos = (counts_pos + 8 * 8 + 3) / 4 * 4;
+	bad = good;
+	put_uint(bad, counts_pos, 24, 8);
+	CHECK_THROWS_AS(load(bad), Dictionary_Loading_Error);
+	bad = good;
+	put_uint(bad, counts_pos, uint64_t(1) << 60, 8);
+	CHECK_THROWS_AS(load(bad), Dictionary_Loading_Error);
+	for (auto field : {0, 4, 8}) {
+		bad = good;
+		put_uint(bad, entries_pos + field, UINT32_MAX, 4);
+		CHECK_THROWS_AS(load(bad), Dictionary_Loading_Error);
+	}
+
+	// Corrupted bytes may or may not give a valid file, but loading must
+	// either throw Dictionary_Loading_Error or give a usable dictionary.
+	for (size_t i = 0; i != good.size(); ++i) {
+		for (auto x : {0x01, 0x80, 0xFF}) {
+			bad = good;
+			bad[i] ^= char(x);
+			try {
+				auto d2 = load(bad);
+				d2.spell("hellos");
+				d2.spell("foofoo");
+			}
+			catch (const Dictionary_Loading_Error&) {
+			}
+		}
+	}
+	remove(path.c_str());
+}
+
+TEST_CASE("Aff_Data load_compiled views the words in place")
+{
+	auto aff = istringstream("SET UTF-8\nFLAG long\nFORBIDDENWORD Fb\n");
+	auto dic = istringstream("4\nhello/Aa\nworld\nhello/Fb\nfoo/Aa\n");
+	auto a = Aff_Data();
+	REQUIRE(a.parse_aff_dic(aff, dic));
+	auto out = ostringstream();
+	REQUIRE(a.save_compiled(out));
+	auto data = make_shared<string>(out.str());
+
+	auto b = Aff_Data();
+	REQUIRE(b.load_compiled(*data, data));
+	CHECK(b.words.is_frozen());
+	CHECK(b.words.size() == 4);
+	auto is_in = [](string_view s, const string& d) {
+		return s.data() >= d.data() &&
+		       s.data() + s.size() <= d.data() + d.size();
+	};
+	auto [first, last] = b.words.equal_range("hello");
+	REQUIRE(last - first == 2);
+	CHECK(is_in(first->first, *data));
+	CHECK(first->second->roles != (first + 1)->second->roles);
+	CHECK(b.words.might_contain("world"));
+	CHECK(size(b.words.distinct_flag_sets()) == 3);
+
+	// The copies share the viewed words and keep the data alive.
+	auto copy = b.words;
+	CHECK(copy.is_frozen());
+	CHECK(copy.equal_range("hello").first->first.data() ==
+	      first->first.data());
+	auto moved = move(b.words);
+	auto weak = weak_ptr<string>(data);
+	data.reset();
+	CHECK_FALSE(weak.expired());
+	auto foos = moved.equal_range("foo");
+	CHECK(foos.first != foos.second);
+	auto worlds = copy.equal_range("world");
+	CHECK(worlds.first != worlds.second);
+	moved.emplace("bar", u"");
+	auto bars = moved.equal_range("bar");
+	CHECK(bars.first != bars.second);
+	auto hellos = moved.equal_range("hello");
+	CHECK(hellos.second - hellos.first == 2);
+	// The words added after loading are copied.
+	auto copy2 = moved;
+	CHECK(copy2.equal_range("hello").first->first.data() ==
+	      hellos.first->first.data());
+	CHECK(copy2.equal_range("bar").first->first.data() !=
+	      bars.first->first.data());
+	moved = Word_List();
+	bars = copy2.equal_range("bar");
+	REQUIRE(bars.first != bars.second);
+	CHECK(bars.first->first == "bar");
+
+	// Without an owner the words are copied.
+	auto c = Aff_Data();
+	auto data2 = out.str();
+	REQUIRE(c.load_compiled(data2, nullptr));
+	CHECK(c.words.is_frozen());
+	auto hello = c.words.equal_range("hello").first;
+	CHECK_FALSE(is_in(hello->first, data2));
+}
+
+TEST_CASE("Dictionary spell cache")
+{
+	auto aff = istringstream("SET UTF-8\n");
+	auto dic = istringstream("2\nhello\nworld\n");
+	auto d = Dictionary::load_from_aff_dic(aff, dic);
+	REQUIRE(d.spell_cache_statistics().capacity == 0);
+	d.set_spell_cache_capacity(100);
+	for (auto i = 0; i != 3; ++i) {
+		REQUIRE(d.spell("hello"));
+		REQUIRE_FALSE(d.spell("helo"));
+	}
+	auto st = d.spell_cache_statistics();
+	REQUIRE(st.size == 2);
+	REQUIRE(st.misses == 2);
+	REQUIRE(st.hits == 4);
+	d.set_spell_cache_capacity(0);
+	REQUIRE(d.spell("world"));
+	REQUIRE(d.spell_cache_statistics().size == 0);
+}
+
+TEST_CASE("Dictionary suggest cache")
+{
+	auto aff = istringstream("SET UTF-8\nTRY abcdefghijklmnopqrstuvwxyz\n");
+	auto dic = istringstream("2\nhello\nworld\n");
+	auto d = Dictionary::load_from_aff_dic(aff, dic);
+	REQUIRE(d.suggest_cache_statistics().capacity == 0);
+	d.set_suggest_cache_capacity(1 << 16);
+	auto expected = vector<string>();
+	d.suggest("helo", expected);
+	REQUIRE(expected == vector<string>{"hello"});
+	auto sugs = vector<string>();
+	d.suggest("helo", sugs);
+	REQUIRE(sugs == expected);
+	auto st = d.suggest_cache_statistics();
+	REQUIRE(st.size == 1);
+	REQUIRE(st.hits == 1);
+	REQUIRE(st.misses == 1);
+	REQUIRE(st.charge > 0);
+	REQUIRE(st.charge <= st.capacity);
+	d.set_suggest_cache_capacity(0);
+	REQUIRE(d.suggest_cache_statistics().size == 0);
+}
+
+TEST_CASE("Dictionary suggest budget")
+{
+	auto aff = istringstream("SET UTF-8\nTRY esianrtolcdugmphbyfvkwz\n");
+	auto dic = istringstream("5\nhello\nworld\nwonderful\nyellow\nmellow\n");
+	auto d = Dictionary::load_from_aff_dic(aff, dic);
+	auto expected = vector<string>();
+	d.suggest("helol", expected);
+	REQUIRE_FALSE(expected.empty());
+	auto sugs = vector<string>();
+
+	auto budget = Suggest_Budget();
+	d.suggest("helol", sugs, budget);
+	CHECK(sugs == expected);
+	CHECK_FALSE(budget.truncated);
+	CHECK(budget.work > 0);
+
+	auto work_needed = budget.work;
+	budget = Suggest_Budget();
+	budget.max_work = work_needed / 2;
+	d.suggest("helol", sugs, budget);
+	CHECK(budget.truncated);
+	CHECK(budget.work <= budget.max_work);
+
+	budget = Suggest_Budget();
+	budget.max_work = 0;
+	d.suggest("helol", sugs, budget);
+	CHECK(budget.truncated);
+	CHECK(sugs.empty());
+
+	budget = Suggest_Budget();
+	budget.deadline = chrono::steady_clock::now();
+	d.suggest("wrold", sugs, budget);
+	CHECK(budget.truncated);
+	CHECK(sugs.empty());
+
+	// Truncated results are not cached.
+	d.set_suggest_cache_capacity(1 << 16);
+	budget = Suggest_Budget();
+	budget.max_work = 0;
+	d.suggest("helol", sugs, budget);
+	CHECK(sugs.empty());
+	d.suggest("helol", sugs);
+	CHECK(sugs == expected);
+	budget = Suggest_Budget();
+	budget.max_work = 0;
+	d.suggest("helol", sugs, budget);
+	CHECK(sugs == expected);
+	CHECK_FALSE(budget.truncated);
+}
+
+TEST_CASE("Dictionary ngram image")
+{
+	auto aff = istringstream("SET UTF-8\nSFX S Y 1\nSFX S 0 s .\n");
+	auto dic = istringstream(
+	    "6\nhello/S\nworld/S\nWörter\nÄrger\nwonderful\nyellow/S\n");
+	auto d = Dictionary::load_from_aff_dic(aff, dic);
+	auto words = {"helol", "wrodl", "wortter", "arger", "wnodrefl",
+	              "yelolws", "ARGER"};
+	auto expected = vector<vector<string>>();
+	auto sugs = vector<string>();
+	for (auto w : words) {
+		d.suggest(w, sugs);
+		expected.push_back(sugs);
+	}
+	d.set_ngram_image_enabled(true);
+	for (auto i = 0; i != 3; ++i) {
+		auto copy = d;
+		auto it = begin(expected);
+		for (auto w : words) {
+			copy.suggest(w, sugs);
+			CHECK(sugs == *it++);
+		}
+		REQUIRE(d.freeze());
+	}
+}
+
+TEST_CASE("Ngram_Image trigram index")
+{
+	auto img = Ngram_Image();
+	for (auto w : {U"abcd", U"bcde", U"xyz", U"ab", U"zabc"}) {
+		auto e = Ngram_Image::Entry();
+		e.lower_begin = e.word_begin = size(img.chars);
+		e.lower_size = e.word_size = u32string_view(w).size();
+		img.chars += w;
+		img.entries.push_back(e);
+	}
+	REQUIRE_FALSE(img.has_index());
+	img.build_index();
+	REQUIRE(img.has_index());
+	auto c = vector<size_t>();
+	CHECK(img.find_candidates(U"abc", c, 5));
+	CHECK(c == vector<size_t>{0, 4});
+	CHECK(img.find_candidates(U"zzbcdxyz", c, 5));
+	CHECK(c == vector<size_t>{0, 1, 2});
+	CHECK(img.find_candidates(U"ab", c, 5));
+	CHECK(c.empty());
+	CHECK(img.find_candidates(U"qqq", c, 5));
+	CHECK(c.empty());
+
+	// The posting lists of bcd and abc hold 4 entries, with a duplicate.
+	CHECK(img.find_candidates(U"abcd", c, 4));
+	CHECK(c == vector<size_t>{0, 1, 4});
+	CHECK_FALSE(img.find_candidates(U"abcd", c, 3));
+	CHECK(c.empty());
+}
+
+TEST_CASE("ngram similarity")
+{
+	CHECK(ngram_similarity_low_level(3, U"", U"abc") == 0);
+	CHECK(ngram_similarity_low_level(3, U"abc", U"") == 0);
+	CHECK(ngram_similarity_low_level(3, U"abcd", U"xabcx") == 3 + 2 + 1);
+	CHECK(ngram_similarity_low_level(3, U"aaaa", U"xa") == 4 + 0);
+	CHECK(ngram_similarity_weighted_low_level(2, U"ab", U"b") ==
+	      1 - 2 - 2);
+
+	// The bit-parallel kernels are compared with the find-based ones,
+	// which they use only for strings longer than 64 characters.
+	auto rnd = Random_Strings{54321};
+	for (auto i = 0; i != 400; ++i) {
+		auto alphabet = 2 + i % 12;
+		auto a = rnd.get(rnd.next() >> 16 & 15, alphabet);
+		auto b = rnd.get(rnd.next() >> 16 & 15, alphabet);
+		if (i % 20 == 0)
+			a = rnd.get(60 + i % 8, alphabet);
+		if (i % 20 == 10)
+			b = rnd.get(60 + i % 8, alphabet);
+		for (auto n : {size_t(1), size_t(2), size_t(3), size_t(4),
+		               a.size()}) {
+			CHECK(ngram_similarity_low_level(n, a, b) ==
+			      ngram_similarity_by_find(n, a, b));
+			CHECK(ngram_similarity_weighted_low_level(n, a, b) ==
+			      ngram_similarity_weighted_by_find(n, a, b));
+		}
+	}
+}
+
+TEST_CASE("longest_common_subsequence_length")
+{
+	auto reference = [](u32string_view a, u32string_view b) {
+		auto t = vector<vector<ptrdiff_t>>(
+		    a.size() + 1, vector<ptrdiff_t>(b.size() + 1));
+		for (size_t i = 1; i <= a.size(); ++i)
+			for (size_t j = 1; j <= b.size(); ++j)
+				t[i][j] = a[i - 1] == b[j - 1]
+				              ? t[i - 1][j - 1] + 1
+				              : max(t[i - 1][j], t[i][j - 1]);
+		return t[a.size()][b.size()];
+	};
+	auto buf = vector<size_t>();
+	CHECK(longest_common_subsequence_length(U"", U"abc", buf) == 0);
+	CHECK(longest_common_subsequence_length(U"abc", U"", buf) == 0);
+	CHECK(longest_common_subsequence_length(U"abcbdab", U"bdcaba", buf) ==
+	      4);
+	CHECK(longest_common_subsequence_length(U"ÄöüÄ", U"xÄüÄy", buf) ==
+	      3);
+
+	// Pseudo-random strings over small alphabets, many of them longer
+	// than 64 characters, compared with the textbook algorithm.
+	auto rnd = Random_Strings{12345};
+	for (auto i = 0; i != 300; ++i) {
+		auto a = rnd.get(rnd.next() >> 16 & 127, 2 + i % 30);
+		auto b = rnd.get(rnd.next() >> 16 & 127, 2 + i % 30);
+		CHECK(longest_common_subsequence_length(a, b, buf) ==
+		      reference(a, b));
+	}
+	for (auto len : {63, 64, 65}) {
+		auto a = rnd.get(len, 5);
+		auto b = rnd.get(len, 5);
+		CHECK(longest_common_subsequence_length(a, b, buf) ==
+		      reference(a, b));
+		CHECK(longest_common_subsequence_length(a, a, buf) == len);
+	}
+}
+
+TEST_CASE("Dictionary ngram index")
+{
+	// All roots that share a letter with the wrong words share the trigram
+	// xyz too, so the index gives the same suggestions as the full scan.
+	// The others are there so that the candidates are few enough for the
+	// index to be used. They change the order in which the roots are added,
+	// and with it the order of the suggestions with equal scores, so the
+	// suggestions are compared sorted.
+	auto dic_text = string("2000\n");
+	for (auto i = 0; i != 400; ++i) {
+		auto w = string("xyz");
+		for (auto j = i; j != 0; j /= 7)
+			w += char('a' + j % 7);
+		dic_text += w + '\n';
+	}
+	for (auto i = 0; i != 1600; ++i) {
+		auto w = string();
+		for (auto j = 0, k = i; j != 4; ++j, k /= 8)
+			w += "hijklmno"[k % 8];
+		dic_text += w + '\n';
+	}
+	auto aff = istringstream("SET UTF-8\n");
+	auto dic = istringstream(dic_text);
+	auto d = Dictionary::load_from_aff_dic(aff, dic);
+	auto words = {"xyzcdgq", "qxyzfa", "xyzggggg", "axyzcdeab"};
+	auto expected = vector<vector<string>>();
+	auto sugs = vector<string>();
+	for (auto w : words) {
+		d.suggest(w, sugs);
+		CHECK_FALSE(sugs.empty());
+		sort(begin(sugs), end(sugs));
+		expected.push_back(sugs);
+	}
+	d.set_ngram_index_enabled(true);
+	auto it = begin(expected);
+	for (auto w : words) {
+		d.suggest(w, sugs);
+		sort(begin(sugs), end(sugs));
+		CHECK(sugs == *it++);
+	}
+}
+
+TEST_CASE("Dictionary ngram index misses")
+{
+	// The best root shares no trigram with the wrong word, while 120 worse
+	// roots share the trigram ert, so it is missed with the index.
+	auto root_text = string("qwxerxtyxu\n");
+	for (auto i = 0; i != 120; ++i) {
+		auto w = string("ert");
+		for (auto j = 0, k = i; j != 3; ++j, k /= 7)
+			w += "abcdfgh"[k % 7];
+		root_text += w + '\n';
+	}
+	auto other_text = string();
+	for (auto i = 0; i != 500; ++i) {
+		auto w = string();
+		for (auto j = 0, k = i; j != 5; ++j, k /= 8)
+			w += "ijklmnop"[k % 8];
+		other_text += w + '\n';
+	}
+
+	// Such a root scores at most 2n + 1, see set_ngram_index_enabled().
+	auto wrong = u32string_view(U"qwertyu");
+	auto root = u32string_view(U"qwxerxtyxu");
+	auto common_prefix = 2;
+	CHECK(ngram_similarity_low_level(3, wrong, root) + common_prefix <=
+	      ptrdiff_t(2 * size(wrong) + 1));
+
+	auto aff = istringstream("SET UTF-8\n");
+	auto dic = istringstream("621\n" + root_text + other_text);
+	auto d = Dictionary::load_from_aff_dic(aff, dic);
+	auto sugs = vector<string>();
+	d.suggest("qwertyu", sugs);
+	CHECK(sugs == vector<string>{"qwxerxtyxu"});
+	d.set_ngram_index_enabled(true);
+	d.suggest("qwertyu", sugs);
+	CHECK(sugs.empty());
+
+	// The cached suggestions are not reused after the index is toggled,
+	// neither by the dictionary nor by its copies.
+	aff = istringstream("SET UTF-8\n");
+	dic = istringstream("621\n" + root_text + other_text);
+	d = Dictionary::load_from_aff_dic(aff, dic);
+	d.set_suggest_cache_capacity(100000);
+	d.suggest("qwertyu", sugs);
+	CHECK(sugs == vector<string>{"qwxerxtyxu"});
+	auto d2 = d;
+	d2.set_ngram_index_enabled(true);
+	d2.suggest("qwertyu", sugs);
+	CHECK(sugs.empty());
+	d.suggest("qwertyu", sugs);
+	CHECK(sugs == vector<string>{"qwxerxtyxu"});
+	CHECK(d.suggest_cache_statistics().hits == 1);
+	d2.set_ngram_image_enabled(false);
+	d2.suggest("qwertyu", sugs);
+	CHECK(sugs == vector<string>{"qwxerxtyxu"});
+	CHECK(d2.suggest_cache_statistics().hits == 0);
+
+	// Without the other roots, the candidates are more than a quarter of
+	// the roots and all of them are scanned.
+	aff = istringstream("SET UTF-8\n");
+	dic = istringstream("121\n" + root_text);
+	d = Dictionary::load_from_aff_dic(aff, dic);
+	d.set_ngram_index_enabled(true);
+	d.suggest("qwertyu", sugs);
+	CHECK(sugs == vector<string>{"qwxerxtyxu"});
+}
+
+TEST_CASE("Dictionary ngram threads")
+{
+	// Many roots have equal scores, so the order in which they are added
+	// matters for the result.
+	auto syllables = {"ka", "to", "ri", "ne", "mu", "sa", "lo",
+	                  "pi", "de", "vu", "ba", "ge", "fo", "hi",
+	                  "ju", "ze", "wa", "ly", "co", "xi"};
+	auto dic_text = string("32000\n");
+	for (auto suffix : {"", "n", "s", "r"})
+		for (auto a : syllables)
+			for (auto b : syllables)
+				for (auto c : syllables)
+					dic_text += string(a) + b + c + suffix +
+					            '\n';
+	auto aff = istringstream("SET UTF-8\n");
+	auto dic = istringstream(dic_text);
+	auto d = Dictionary::load_from_aff_dic(aff, dic);
+	auto words = {"katorix", "nemusalx", "pidevuq", "xirimuka", "bageo",
+	              "lyrizen"};
+	auto expected = vector<vector<string>>();
+	auto sugs = vector<string>();
+	for (auto w : words) {
+		d.suggest(w, sugs);
+		CHECK_FALSE(sugs.empty());
+		expected.push_back(sugs);
+	}
+	d.set_ngram_threads(4);
+	for (auto image : {false, true}) {
+		d.set_ngram_image_enabled(image);
+		auto it = begin(expected);
+		for (auto w : words) {
+			d.suggest(w, sugs);
+			CHECK(sugs == *it++);
+		}
+		// The budget runs out during the root scan.
+		auto budget = Suggest_Budget();
+		budget.max_work = 20000;
+		d.suggest("katorix", sugs, budget);
+		CHECK(budget.truncated);
+		CHECK(budget.work <= budget.max_work);
+	}
+
+	// The threads and their buffers are reused by the next calls, so
+	// after warm-up the scan allocates as much as with one thread.
+	for (auto image : {false, true}) {
+		d.set_ngram_image_enabled(image);
+		auto num_allocations_with = [&](size_t threads) -> size_t {
+			d.set_ngram_threads(threads);
+			for (auto i = 0; i != 2; ++i)
+				d.suggest("katorix", sugs);
+			size_t old_num_allocations = num_allocations;
+			d.suggest("katorix", sugs);
+			CHECK(sugs == expected[0]);
+			return num_allocations - old_num_allocations;
+		};
+		CHECK(num_allocations_with(4) == num_allocations_with(1));
+	}
+}
+
+TEST_CASE("Dictionary spell does not allocate")
+{
+	auto aff = istringstream(R"(SET UTF-8
+COMPOUNDFLAG X
+SFX S Y 1
+SFX S 0 s .
+PFX U Y 1
+PFX U 0 un .
+)");
+	auto dic = istringstream(R"(5
+hello/SU
+world/S
+internationalization/S
+foo/X
+bar/X
+)");
+	auto d = Dictionary::load_from_aff_dic(aff, dic);
+	auto words = {"hello",
+	              "hellos",
+	              "unhello",
+	              "Hello",
+	              "HELLO",
+	              "helo",
+	              "hello-world",
+	              "internationalizations",
+	              "Internationalization",
+	              "internationalizationz",
+	              "foobar",
+	              "foobaz",
+	              "hello."};
+	for (auto i = 0; i != 2; ++i)
+		for (auto w : words)
+			d.spell(w);
+	size_t old_num_allocations = num_allocations;
+	for (auto w : words)
+		d.spell(w);
+	CHECK(num_allocations == old_num_allocations);
+
+	auto ctx = Spell_Context();
+	for (auto w : words)
+		CHECK(d.spell(w, ctx) == d.spell(w));
+	old_num_allocations = num_allocations;
+	for (auto w : words)
+		d.spell(w, ctx);
+	CHECK(num_allocations == old_num_allocations);
+
+	auto sugs1 = vector<string>();
+	auto sugs2 = vector<string>();
+	d.suggest("helo", sugs1);
+	d.suggest("helo", sugs2, ctx);
+	CHECK(sugs1 == sugs2);
+
+	auto ctx2 = move(ctx);
+	CHECK(d.spell("hello", ctx2));
+	CHECK(d.spell("hello", ctx));
+}